@@ -0,0 +1,293 @@
+#include "dashboard.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// The dashboard used to be served by the PHP tier, which asked the Pico 2W for every browser's poll:
+// more viewers, more load on the Pico's 4 KB lwIP heap. Here the ESP32 serves it instead. The page
+// itself is in flash (../web, gzipped at build time), and the live values come from the telemetry the
+// master already streams over the UART link, so the Pico's load does not depend on how many browsers
+// are watching.
+//
+// Assets carry an ETag (a hash of the compressed bytes) and "no-cache": a browser revalidates on every
+// load, and an unchanged asset costs a 304 with no body. /api/live does the same with the master's
+// snapshot seq as the ETag.
+//
+// /api/events is a server-sent event stream. The handler takes the connection out of the server with
+// httpd_req_async_handler_begin() and gives it to the stream task, so an open stream does not tie up
+// the server task. The task formats each event once and sends it to every stream. A send that fails
+// (browser gone, or the socket purged by the server) closes that stream; EventSource reconnects on
+// its own. A browser that stops reading can hold up the loop for the server's send timeout.
+
+#define DASH_SSE_STACK 4096
+#define DASH_SSE_PRIO 5
+#define DASH_ETAG_LEN 12  // quoted 8 hex digits
+#define DASH_LIVE_MAX 192 // one /api/live body
+#define DASH_SSE_RETRY "retry: 2000\n\n" // EventSource reconnect delay, ms
+#define DASH_SSE_KEEPALIVE ": keepalive\n\n"
+
+typedef struct
+{
+    const char *uri;
+    const char *type;
+    const uint8_t *start;
+    const uint8_t *end;
+    char etag[DASH_ETAG_LEN];
+} dash_asset_t;
+
+// Linked in by src/CMakeLists.txt
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+extern const uint8_t app_js_gz_start[] asm("_binary_app_js_gz_start");
+extern const uint8_t app_js_gz_end[] asm("_binary_app_js_gz_end");
+extern const uint8_t styles_css_gz_start[] asm("_binary_styles_css_gz_start");
+extern const uint8_t styles_css_gz_end[] asm("_binary_styles_css_gz_end");
+
+static dash_asset_t dash_assets[] = {
+    {.uri = "/", .type = "text/html", .start = index_html_gz_start, .end = index_html_gz_end},
+    {.uri = "/app.js", .type = "application/javascript", .start = app_js_gz_start, .end = app_js_gz_end},
+    {.uri = "/styles.css", .type = "text/css", .start = styles_css_gz_start, .end = styles_css_gz_end},
+};
+
+static const char *TAG = "DASHBOARD";
+
+static QueueHandle_t dash_sse_new; // streams waiting to be adopted by the task
+static TaskHandle_t dash_sse_handle;
+static httpd_req_t *dash_sse[DASH_SSE_CLIENTS]; // stream task only
+
+// Each counter has one writer: clients, events and dropped the stream task, the rest the server task
+static dashboard_stats_t dash_stats;
+
+/* ===================== ETAGS ===================== */
+
+static uint32_t dash_fnv1a(const uint8_t *p, size_t n)
+{
+    uint32_t h = 2166136261u;
+    while (n--)
+    {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool dash_etag_match(httpd_req_t *req, const char *etag)
+{
+    char inm[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) != ESP_OK)
+        return false;
+    return strstr(inm, etag) != NULL;
+}
+
+static esp_err_t dash_not_modified(httpd_req_t *req, const char *etag)
+{
+    dash_stats.not_modified++;
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* ===================== ASSETS ===================== */
+
+esp_err_t dashboard_asset_handler(httpd_req_t *req)
+{
+    size_t n = strcspn(req->uri, "?");
+    const dash_asset_t *a = NULL;
+
+    for (size_t i = 0; i < sizeof(dash_assets) / sizeof(dash_assets[0]); i++)
+    {
+        if (strlen(dash_assets[i].uri) == n && strncmp(req->uri, dash_assets[i].uri, n) == 0)
+            a = &dash_assets[i];
+    }
+    if (!a)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_OK;
+    }
+    if (dash_etag_match(req, a->etag))
+        return dash_not_modified(req, a->etag);
+
+    httpd_resp_set_type(req, a->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "ETag", a->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache"); // always revalidate; a 304 is a few bytes
+    return httpd_resp_send(req, (const char *)a->start, a->end - a->start);
+}
+
+/* ===================== LIVE ===================== */
+
+static int dash_live_json(char *buf, size_t len, const link_telemetry_t *t, bool have)
+{
+    if (!have)
+        return snprintf(buf, len, "{\"temperature\":0,\"led\":0,\"raw\":0,\"timestamp\":0,\"seq\":0,"
+                                  "\"applied\":0,\"age_ms\":-1}");
+
+    return snprintf(buf, len,
+                    "{\"temperature\":%u,\"led\":%u,\"raw\":%lu,\"timestamp\":%lu,\"seq\":%lu,"
+                    "\"applied\":%u,\"age_ms\":%lld}",
+                    t->temperature, t->led, (unsigned long)t->raw, (unsigned long)t->timestamp,
+                    (unsigned long)t->seq, t->applied, (long long)((esp_timer_get_time() - t->rx_us) / 1000));
+}
+
+esp_err_t dashboard_live_handler(httpd_req_t *req)
+{
+    link_telemetry_t t;
+    bool have = uart_link_telemetry(&t);
+    char etag[DASH_ETAG_LEN + 2];
+    snprintf(etag, sizeof(etag), "W/\"%lx\"", have ? (unsigned long)t.seq : 0UL);
+
+    if (have && dash_etag_match(req, etag))
+        return dash_not_modified(req, etag);
+
+    char body[DASH_LIVE_MAX];
+    dash_live_json(body, sizeof(body), &t, have);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, body, HTTPD_RESP_USE_STRLEN);
+}
+
+/* ===================== EVENT STREAM ===================== */
+
+static void dash_sse_close(int i)
+{
+    httpd_req_async_handler_complete(dash_sse[i]);
+    dash_sse[i] = NULL;
+    dash_stats.clients--;
+}
+
+static bool dash_sse_send(int i, const char *msg, size_t len)
+{
+    if (httpd_resp_send_chunk(dash_sse[i], msg, len) != ESP_OK)
+    {
+        dash_sse_close(i);
+        dash_stats.dropped++;
+        return false;
+    }
+    return true;
+}
+
+static void dash_sse_broadcast(const char *msg, size_t len, bool event)
+{
+    for (int i = 0; i < DASH_SSE_CLIENTS; i++)
+    {
+        if (dash_sse[i] && dash_sse_send(i, msg, len) && event)
+            dash_stats.events++;
+    }
+}
+
+// Starts a new stream with the current state, so the page fills in without waiting for a change
+static void dash_sse_adopt(httpd_req_t *req, const char *msg, size_t len)
+{
+    int i = 0;
+    while (i < DASH_SSE_CLIENTS && dash_sse[i])
+        i++;
+    if (i == DASH_SSE_CLIENTS)
+    {
+        // More streams were queued than there were free slots when the handler counted them
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, NULL, 0);
+        httpd_req_async_handler_complete(req);
+        return;
+    }
+
+    dash_sse[i] = req;
+    dash_stats.clients++;
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (dash_sse_send(i, DASH_SSE_RETRY, strlen(DASH_SSE_RETRY)) && dash_sse_send(i, msg, len))
+        dash_stats.events++;
+}
+
+static void dash_sse_task(void *arg)
+{
+    (void)arg;
+    char msg[DASH_LIVE_MAX + 32];
+    char json[DASH_LIVE_MAX];
+    bool sent = false;
+    uint32_t sent_seq = 0;
+    int64_t last_us = 0;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DASH_SSE_KEEPALIVE_MS));
+
+        link_telemetry_t t;
+        bool have = uart_link_telemetry(&t);
+        dash_live_json(json, sizeof(json), &t, have);
+        int len = snprintf(msg, sizeof(msg), "id: %lu\ndata: %s\n\n", have ? (unsigned long)t.seq : 0UL, json);
+
+        httpd_req_t *req;
+        while (xQueueReceive(dash_sse_new, &req, 0) == pdTRUE)
+            dash_sse_adopt(req, msg, len);
+
+        int64_t now = esp_timer_get_time();
+        if (have && (!sent || t.seq != sent_seq))
+        {
+            dash_sse_broadcast(msg, len, true);
+            sent = true;
+            sent_seq = t.seq;
+            last_us = now;
+
+            // Whatever arrives meanwhile goes out as one event
+            vTaskDelay(pdMS_TO_TICKS(DASH_SSE_MIN_MS));
+        }
+        else if (now - last_us >= DASH_SSE_KEEPALIVE_MS * 1000LL)
+        {
+            dash_sse_broadcast(DASH_SSE_KEEPALIVE, strlen(DASH_SSE_KEEPALIVE), false);
+            last_us = now;
+        }
+    }
+}
+
+esp_err_t dashboard_events_handler(httpd_req_t *req)
+{
+    if (dash_stats.clients >= DASH_SSE_CLIENTS)
+    {
+        dash_stats.rejected++;
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "10");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_req_t *copy;
+    if (httpd_req_async_handler_begin(req, &copy) != ESP_OK)
+        return ESP_FAIL;
+    if (xQueueSend(dash_sse_new, &copy, 0) != pdTRUE)
+    {
+        httpd_req_async_handler_complete(copy);
+        return ESP_FAIL;
+    }
+    xTaskNotifyGive(dash_sse_handle);
+    return ESP_OK;
+}
+
+/* ===================== SETUP ===================== */
+
+void dashboard_publish(void)
+{
+    if (dash_sse_handle)
+        xTaskNotifyGive(dash_sse_handle);
+}
+
+void dashboard_init(void)
+{
+    for (size_t i = 0; i < sizeof(dash_assets) / sizeof(dash_assets[0]); i++)
+    {
+        dash_asset_t *a = &dash_assets[i];
+        snprintf(a->etag, sizeof(a->etag), "\"%08lx\"", (unsigned long)dash_fnv1a(a->start, a->end - a->start));
+        ESP_LOGI(TAG, "%s: %u bytes gzipped, ETag %s", a->uri, (unsigned)(a->end - a->start), a->etag);
+    }
+
+    dash_sse_new = xQueueCreate(DASH_SSE_CLIENTS, sizeof(httpd_req_t *));
+    xTaskCreate(dash_sse_task, "dash_sse", DASH_SSE_STACK, NULL, DASH_SSE_PRIO, &dash_sse_handle);
+}
+
+void dashboard_stats(dashboard_stats_t *out)
+{
+    *out = dash_stats; // counters only; a torn read is off by one at worst
+}
@@ -0,0 +1,63 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include "esp_http_server.h"
+#include "uart_link.h"
+
+// Browsers streaming /api/events at once; one more gets 503 and its EventSource retries
+#define DASH_SSE_CLIENTS 8
+
+// Shortest gap between two events, so a burst of telemetry becomes one event
+#define DASH_SSE_MIN_MS 250
+
+// A comment line is sent this often when nothing changes, so proxies and browsers keep the stream open
+#define DASH_SSE_KEEPALIVE_MS 15000
+
+/**
+ * @brief Dashboard counters
+ */
+typedef struct
+{
+    uint32_t clients;      /*!< event streams open now */
+    uint32_t events;       /*!< events sent, summed over streams */
+    uint32_t dropped;      /*!< streams closed because a send failed */
+    uint32_t rejected;     /*!< streams refused, DASH_SSE_CLIENTS already open */
+    uint32_t not_modified; /*!< 304 answers to If-None-Match */
+} dashboard_stats_t;
+
+/**
+ * @brief Hashes the embedded assets for their ETags and starts the event stream task
+ */
+void dashboard_init(void);
+
+/**
+ * @brief Wakes the event stream task for a new telemetry frame
+ *
+ * Called from the UART link task. Only a notification: the task reads the frame back with
+ * uart_link_telemetry() when it runs.
+ */
+void dashboard_publish(void);
+
+/**
+ * @brief GET /, /app.js and /styles.css: the gzipped dashboard, with ETag revalidation
+ */
+esp_err_t dashboard_asset_handler(httpd_req_t *req);
+
+/**
+ * @brief GET /api/live: the latest telemetry as JSON, ETag is the master's snapshot seq
+ */
+esp_err_t dashboard_live_handler(httpd_req_t *req);
+
+/**
+ * @brief GET /api/events: server-sent events carrying the same JSON as /api/live
+ *
+ * Hands the connection to the event stream task and returns at once.
+ */
+esp_err_t dashboard_events_handler(httpd_req_t *req);
+
+/**
+ * @brief Copies the dashboard counters
+ */
+void dashboard_stats(dashboard_stats_t *out);
+
+#endif /* DASHBOARD_H */
@@ -14,8 +14,12 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_idf_version.h"
+#include "esp_rom_sys.h"
 #include "esp_lcd.h"
 #include "esp_log.h"
+#if SOC_DEDICATED_GPIO_SUPPORTED
+#include "hal/dedic_gpio_cpu_ll.h"
+#endif
 
 /* LCD tag */
 static const char *lcd_tag = "LCD tag"; /*! < LCD tag */
@@ -33,42 +37,71 @@ static const char *lcd_tag = "LCD tag"; /*! < LCD tag */
 #define ENABLE_PIN 22          /*!< Enable  */
 #define REGISTER_SELECT_PIN 23 /*!< Register Select  */
 
+/* HD44780 timing, microseconds. Pulse widths and setup times are all well under 1 us, the smallest
+ * esp_rom_delay_us() step. Execution times are the datasheet's at 270 kHz, with margin for a slower
+ * oscillator. */
+#define LCD_SETUP_US 1    /*!< RS and data stable before EN rises */
+#define LCD_PULSE_US 1    /*!< EN high time */
+#define LCD_EXEC_US 40    /*!< most instructions and data writes: 37 us */
+#define LCD_CLEAR_US 2000 /*!< clear display and return home: 1.52 ms */
+
+/* Bundle channels, in the order lcdCtor() passes the pins */
+#define LCD_BUNDLE_DATA 0x0F                      /*!< D4..D7 */
+#define LCD_BUNDLE_RS (1u << LCD_DATA_LINE)       /*!< register select */
+#define LCD_BUNDLE_EN (1u << (LCD_DATA_LINE + 1)) /*!< enable */
+
 /**
- * @brief Trigger LCD enable pin
+ * @brief Write bundle channels
+ *
+ * On chips with dedicated GPIO this is one CPU instruction that sets every channel in mask at once.
  *
  * @param lcd   pointer to LCD object
+ * @param mask  bundle channels to change
+ * @param value their new levels
  * @return None
  */
-static void lcdTriggerEN(lcd_t *const lcd)
+static inline void lcdBusWrite(lcd_t *const lcd, uint32_t mask, uint32_t value)
 {
-    gpio_set_level(lcd->en, GPIO_STATE_LOW);
-    vTaskDelay(1 / portTICK_PERIOD_MS);
-    gpio_set_level(lcd->en, GPIO_STATE_HIGH);
-    vTaskDelay(1 / portTICK_PERIOD_MS);
-    gpio_set_level(lcd->en, GPIO_STATE_LOW);
-    vTaskDelay(1 / portTICK_PERIOD_MS);
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    dedic_gpio_cpu_ll_write_mask(mask << lcd->out_offset, value << lcd->out_offset);
+#else
+    for (int i = 0; i < LCD_DATA_LINE; i++)
+    {
+        if (mask & (1u << i))
+            gpio_set_level(lcd->data[i], (value >> i) & 1);
+    }
+    if (mask & LCD_BUNDLE_RS)
+        gpio_set_level(lcd->regSel, !!(value & LCD_BUNDLE_RS));
+    if (mask & LCD_BUNDLE_EN)
+        gpio_set_level(lcd->en, !!(value & LCD_BUNDLE_EN));
+#endif
 }
 
 /**
- * @brief Transmitt lower nibble
+ * @brief Transmit one nibble
+ *
+ * Data and RS are set together with EN low, then EN is pulsed. The LCD latches on the falling edge.
  *
  * @param lcd   pointer to LCD object
- * @param x     bits
+ * @param x     bits, the low four are sent
+ * @param rs    LCD_BUNDLE_RS for data, 0 for a command
  * @return None
  */
-static void lownibble(lcd_t *const lcd, unsigned char x)
+static void lcdWriteNibble(lcd_t *const lcd, unsigned char x, uint32_t rs)
 {
-    uint8_t i, val = 0x01;
-    for (i = 0; i < LCD_DATA_LINE; i++)
-    {
-        /* check if x is high for every bit */
-        gpio_set_level(lcd->data[i], (x >> i) & val);
-    }
+    lcdBusWrite(lcd, LCD_BUNDLE_DATA | LCD_BUNDLE_RS | LCD_BUNDLE_EN, (x & LCD_BUNDLE_DATA) | rs);
+    esp_rom_delay_us(LCD_SETUP_US);
+    lcdBusWrite(lcd, LCD_BUNDLE_EN, LCD_BUNDLE_EN);
+    esp_rom_delay_us(LCD_PULSE_US);
+    lcdBusWrite(lcd, LCD_BUNDLE_EN, 0);
 }
 
 /**
  * @brief Write command to LCD object
  *
+ * Waits the instruction's execution time after the second nibble, so the next write can follow at
+ * once.
+ *
  * @param lcd       pointer to LCD object
  * @param cmd       LCD command
  * @param lcd_opt   0: data , 1: command
@@ -77,21 +110,16 @@ static void lownibble(lcd_t *const lcd, unsigned char x)
 static void lcdWriteCmd(lcd_t *const lcd, unsigned char cmd, uint8_t lcd_opt)
 {
     /* CMD: 1, DATA: 0 */
-    (lcd_opt == LCD_CMD) ? gpio_set_level(lcd->regSel, GPIO_STATE_LOW) : gpio_set_level(lcd->regSel, GPIO_STATE_HIGH);
+    uint32_t rs = (lcd_opt == LCD_CMD) ? 0 : LCD_BUNDLE_RS;
 
     /* upper bits */
-    lownibble(lcd, cmd >> 4);
-    lcdTriggerEN(lcd);
+    lcdWriteNibble(lcd, cmd >> 4, rs);
 
     /* lower bits */
-    lownibble(lcd, cmd);
-    lcdTriggerEN(lcd);
+    lcdWriteNibble(lcd, cmd, rs);
 
-    /* CMD : 1, DATA: 0 */
-    if (lcd_opt == LCD_CMD)
-    {
-        vTaskDelay(10 / portTICK_PERIOD_MS); /* 10 ms delay */
-    }
+    /* clear and return home take far longer than everything else */
+    esp_rom_delay_us((lcd_opt == LCD_CMD && cmd <= 0x03) ? LCD_CLEAR_US : LCD_EXEC_US);
 }
 
 /**
@@ -106,33 +134,17 @@ void lcdInit(lcd_t *const lcd)
     /* 100 ms delay */
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
-    /* set 0x03 to LCD */
-    gpio_set_level(lcd->en, GPIO_STATE_LOW);
-    gpio_set_level(lcd->regSel, GPIO_STATE_LOW);
-    gpio_set_level(lcd->data[0], GPIO_STATE_HIGH);
-    gpio_set_level(lcd->data[1], GPIO_STATE_HIGH);
-    gpio_set_level(lcd->data[2], GPIO_STATE_LOW);
-    gpio_set_level(lcd->data[3], GPIO_STATE_LOW);
-
-    /* Send 0x03 3 times at 10ms then 100 us */
-    lcdTriggerEN(lcd);
-    vTaskDelay(10 / portTICK_PERIOD_MS);
-    lcdTriggerEN(lcd);
-    vTaskDelay(10 / portTICK_PERIOD_MS);
-    lcdTriggerEN(lcd);
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+    /* Send 0x03 3 times, waiting >4.1 ms, >100 us, >100 us */
+    lcdWriteNibble(lcd, 0x03, 0);
+    esp_rom_delay_us(4500);
+    lcdWriteNibble(lcd, 0x03, 0);
+    esp_rom_delay_us(150);
+    lcdWriteNibble(lcd, 0x03, 0);
+    esp_rom_delay_us(150);
 
     /* switch to 4-bit mode, 0x02 */
-    gpio_set_level(lcd->en, GPIO_STATE_LOW);
-    gpio_set_level(lcd->regSel, GPIO_STATE_LOW);
-    gpio_set_level(lcd->data[0], GPIO_STATE_LOW);
-    gpio_set_level(lcd->data[1], GPIO_STATE_HIGH);
-    gpio_set_level(lcd->data[2], GPIO_STATE_LOW);
-    gpio_set_level(lcd->data[3], GPIO_STATE_LOW);
-
-    /* Trigger enable */
-    lcdTriggerEN(lcd);
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+    lcdWriteNibble(lcd, 0x02, 0);
+    esp_rom_delay_us(LCD_EXEC_US);
 
     /* Initialize LCD */
     lcdWriteCmd(lcd, 0x28, LCD_CMD); // 4-bit, 2 line, 5x8
@@ -165,7 +177,8 @@ void lcdDefault(lcd_t *const lcd)
 /**
  * @brief LCD constructor
  *
- * Detailed description starts here
+ * On chips with dedicated GPIO the pins are grouped into a bundle owned by the calling core. All
+ * later calls on this LCD must run on that same core; from another core they return LCD_FAIL.
  * @param lcd       pointer to LCD object
  * @param data      lcd data array
  * @param en        lcd en
@@ -223,52 +236,110 @@ void lcdCtor(lcd_t *lcd, gpio_num_t data[LCD_DATA_LINE], gpio_num_t en, gpio_num
         gpio_set_level(lcd->data[i], GPIO_STATE_LOW);
     }
 
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    /* Bundle channels: D4..D7, then RS, then EN (LCD_BUNDLE_*) */
+    int pins[LCD_DATA_LINE + 2];
+    for (i = 0; i < LCD_DATA_LINE; i++)
+    {
+        pins[i] = lcd->data[i];
+    }
+    pins[LCD_DATA_LINE] = lcd->regSel;
+    pins[LCD_DATA_LINE + 1] = lcd->en;
+
+    dedic_gpio_bundle_config_t bundle_config = {
+        .gpio_array = pins,
+        .array_size = LCD_DATA_LINE + 2,
+        .flags = {
+            .out_en = 1,
+        },
+    };
+    if (dedic_gpio_new_bundle(&bundle_config, &lcd->bundle) != ESP_OK ||
+        dedic_gpio_get_out_offset(lcd->bundle, &lcd->out_offset) != ESP_OK)
+    {
+        ESP_LOGE(lcd_tag, "No dedicated GPIO channels for the LCD");
+        lcd->state = (lcd_state_t)LCD_INACTIVE;
+        return;
+    }
+    lcd->core = xPortGetCoreID();
+#endif
+
     lcd->state = (lcd_state_t)LCD_ACTIVE;
 }
 
 /**
- * @brief Set text
+ * @brief Check the LCD can be written from here
  *
- * Detailed description starts here
  * @param lcd   pointer to LCD object
- * @param text  string text
+ * @return      true if active and, with dedicated GPIO, called on the bundle's core
+ */
+static bool lcdUsable(lcd_t *const lcd)
+{
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    return lcd->state == LCD_ACTIVE && xPortGetCoreID() == lcd->core;
+#else
+    return lcd->state == LCD_ACTIVE;
+#endif
+}
+
+/**
+ * @brief Write a buffer
+ *
+ * Sets the position once, then writes every byte back to back, each followed only by the
+ * controller's execution time.
+ * @param lcd   pointer to LCD object
+ * @param buf   characters, not necessarily null-terminated
+ * @param len   number of characters
  * @param x     location at x-axis
  * @param y     location at y-axis
  * @return      lcd error status @see lcd_err_t
  */
-lcd_err_t lcdSetText(lcd_t *const lcd, char *text, int x, int y)
+lcd_err_t lcdWriteBuffer(lcd_t *const lcd, const char *buf, size_t len, int x, int y)
 {
-    /* Check if lcd is active */
-    if (lcd->state == LCD_ACTIVE)
+    /* Check if lcd is usable */
+    if (!lcdUsable(lcd))
     {
-        int i;
-        if (x < 16)
-        {
-            x |= 0x80; // Set LCD for first line write
-            switch (y)
-            {
-            case 1:
-                x |= 0x40; // Set LCD for second line write
-                break;
-            case 2:
-                x |= 0x60; // Set LCD for first line write reverse
-                break;
-            case 3:
-                x |= 0x20; // Set LCD for second line write reverse
-                break;
-            }
-            lcdWriteCmd(lcd, x, LCD_CMD);
-        }
-        i = 0;
-        /* Write text */
-        while (text[i] != '\0')
+        return LCD_FAIL;
+    }
+
+    if (x < 16)
+    {
+        x |= 0x80; // Set LCD for first line write
+        switch (y)
         {
-            lcdWriteCmd(lcd, text[i], LCD_DATA);
-            i++;
+        case 1:
+            x |= 0x40; // Set LCD for second line write
+            break;
+        case 2:
+            x |= 0x60; // Set LCD for first line write reverse
+            break;
+        case 3:
+            x |= 0x20; // Set LCD for second line write reverse
+            break;
         }
+        lcdWriteCmd(lcd, x, LCD_CMD);
+    }
+
+    /* Write buffer */
+    for (size_t i = 0; i < len; i++)
+    {
+        lcdWriteCmd(lcd, buf[i], LCD_DATA);
     }
-    /* return lcd status */
-    return lcd->state == LCD_ACTIVE ? LCD_OK : LCD_FAIL;
+    return LCD_OK;
+}
+
+/**
+ * @brief Set text
+ *
+ * Detailed description starts here
+ * @param lcd   pointer to LCD object
+ * @param text  string text
+ * @param x     location at x-axis
+ * @param y     location at y-axis
+ * @return      lcd error status @see lcd_err_t
+ */
+lcd_err_t lcdSetText(lcd_t *const lcd, char *text, int x, int y)
+{
+    return lcdWriteBuffer(lcd, text, strlen(text), x, y);
 }
 
 /**
@@ -283,17 +354,11 @@ lcd_err_t lcdSetText(lcd_t *const lcd, char *text, int x, int y)
  */
 lcd_err_t lcdSetInt(lcd_t *const lcd, int val, int x, int y)
 {
-    /* Check if lcd is active */
-    if (lcd->state == LCD_ACTIVE)
-    {
-        /* Store integer to buffer */
-        char buffer[16];
-        sprintf(buffer, "%d", val);
-        /* Set integer */
-        lcdSetText(lcd, buffer, x, y);
-    }
-    /* return lcd status */
-    return lcd->state == LCD_ACTIVE ? LCD_OK : LCD_FAIL;
+    /* Store integer to buffer */
+    char buffer[16];
+    sprintf(buffer, "%d", val);
+    /* Set integer */
+    return lcdSetText(lcd, buffer, x, y);
 }
 
 /**
@@ -304,15 +369,15 @@ lcd_err_t lcdSetInt(lcd_t *const lcd, int val, int x, int y)
  */
 lcd_err_t lcdClear(lcd_t *const lcd)
 {
-    /* Check if lcd is active */
-    if (lcd->state == LCD_ACTIVE)
+    /* Check if lcd is usable */
+    if (!lcdUsable(lcd))
     {
-        /* Clear LCD screen */
-        lcdWriteCmd(lcd, 0x01, LCD_CMD);
+        return LCD_FAIL;
     }
 
-    /* return lcd status */
-    return lcd->state == LCD_ACTIVE ? LCD_OK : LCD_FAIL;
+    /* Clear LCD screen */
+    lcdWriteCmd(lcd, 0x01, LCD_CMD);
+    return LCD_OK;
 }
 
 /**
@@ -323,6 +388,13 @@ lcd_err_t lcdClear(lcd_t *const lcd)
  */
 void lcdFree(lcd_t *const lcd)
 {
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    /* Release the dedicated GPIO channels */
+    if (lcd->state == LCD_ACTIVE)
+    {
+        dedic_gpio_del_bundle(lcd->bundle);
+    }
+#endif
     /* Reset data pins to default configuration */
     for (int i = 0; i < LCD_DATA_LINE; i++)
     {
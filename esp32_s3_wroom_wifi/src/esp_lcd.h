@@ -10,7 +10,13 @@
 #ifndef _ESP_LCD_H_
 #define _ESP_LCD_H_
 
+#include <stddef.h>
+#include <stdint.h>
 #include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#if SOC_DEDICATED_GPIO_SUPPORTED
+#include "driver/dedic_gpio.h"
+#endif
 
 /* LCD Error */
 typedef int lcd_err_t; /*!< LCD error type */
@@ -50,6 +56,11 @@ typedef struct
     gpio_num_t en;                  /*!< LCD enable pin */
     gpio_num_t regSel;              /*!< LCD register select */
     lcd_state_t state;              /*!< LCD state  */
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    dedic_gpio_bundle_handle_t bundle; /*!< D4..D7, RS, EN as one dedicated GPIO bundle */
+    uint32_t out_offset;               /*!< bundle's first channel in the CPU's GPIO out register */
+    int core;                          /*!< core the bundle belongs to, the only one that can write it */
+#endif
 } lcd_t;
 
 void lcdDefault(lcd_t *const lcd);
@@ -62,6 +73,8 @@ lcd_err_t lcdSetText(lcd_t *const lcd, char *text, int x, int y);
 
 lcd_err_t lcdSetInt(lcd_t *const lcd, int val, int x, int y);
 
+lcd_err_t lcdWriteBuffer(lcd_t *const lcd, const char *buf, size_t len, int x, int y);
+
 lcd_err_t lcdClear(lcd_t *const lcd);
 
 void lcdFree(lcd_t *const lcd);
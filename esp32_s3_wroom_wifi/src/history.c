@@ -0,0 +1,176 @@
+#include "history.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+// Temperature history, fed from the master's telemetry frames as they arrive over the UART link. The
+// Pico 2W keeps only 25 minutes in its own RAM and loses it when it restarts; this ring is far larger
+// and lives on the ESP32, so it outlasts the master and takes long-range queries off it.
+//
+// Records are 8 bytes, appended in time order by the link task. Readers (HTTP tasks) never lock the
+// ring: they take the write position under the spinlock, which is the only shared state, and then
+// read records directly. The time order is the index: a range is found with two binary searches, and
+// only the records inside it are read. Readers stay HISTORY_GUARD records clear of the oldest one,
+// which the writer overwrites next; at the master's fastest poll that is 4 seconds of slack, far
+// longer than any query takes.
+
+#define HISTORY_GUARD 16
+
+typedef struct
+{
+    uint32_t t; // HISTORY_TICK_MS ticks since boot
+    uint16_t temperature;
+    uint8_t led;
+    uint8_t pad;
+} history_rec_t;
+
+static const char *TAG = "HISTORY";
+
+static history_rec_t *history_ring;
+static uint32_t history_mask; // capacity - 1
+static bool history_psram = false;
+static portMUX_TYPE history_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t history_head = 0; // records ever pushed; the newest is history_head - 1
+
+void history_init(void)
+{
+    uint32_t len = HISTORY_PSRAM_LEN;
+
+    // Without CONFIG_SPIRAM there is no SPIRAM heap and this returns NULL
+    history_ring = heap_caps_malloc(len * sizeof(history_rec_t), MALLOC_CAP_SPIRAM);
+    history_psram = history_ring != NULL;
+    if (!history_ring)
+    {
+        len = HISTORY_IRAM_LEN;
+        history_ring = heap_caps_malloc(len * sizeof(history_rec_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!history_ring)
+    {
+        ESP_LOGE(TAG, "No memory for the history ring");
+        return;
+    }
+
+    history_mask = len - 1;
+    ESP_LOGI(TAG, "%lu samples in %s", (unsigned long)len, history_psram ? "PSRAM" : "internal RAM");
+}
+
+void history_push(const link_telemetry_t *t)
+{
+    if (!history_ring)
+        return;
+
+    history_rec_t *r = &history_ring[history_head & history_mask];
+    r->t = (uint32_t)(t->rx_us / (HISTORY_TICK_MS * 1000));
+    r->temperature = t->temperature;
+    r->led = t->led;
+
+    taskENTER_CRITICAL(&history_mux); // also orders the record before the new head
+    history_head++;
+    taskEXIT_CRITICAL(&history_mux);
+}
+
+/* ===================== READERS ===================== */
+
+// Readable records, as indices that only go up: [*lo, *hi)
+static void history_window(uint32_t *lo, uint32_t *hi)
+{
+    taskENTER_CRITICAL(&history_mux);
+    uint32_t head = history_head;
+    taskEXIT_CRITICAL(&history_mux);
+
+    uint32_t keep = history_mask + 1 - HISTORY_GUARD;
+    *hi = head;
+    *lo = head > keep ? head - keep : 0;
+}
+
+static inline uint32_t history_ticks(uint64_t ms)
+{
+    uint64_t t = ms / HISTORY_TICK_MS;
+    return t > UINT32_MAX ? UINT32_MAX : (uint32_t)t;
+}
+
+// First index in [lo, hi) whose time is at or after t
+static uint32_t history_lower(uint32_t lo, uint32_t hi, uint64_t t)
+{
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (history_ring[mid & history_mask].t < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void history_add(history_point_t *p, const history_rec_t *r)
+{
+    if (p->n == 0)
+    {
+        p->t_ms = (uint64_t)r->t * HISTORY_TICK_MS;
+        p->min = p->max = r->temperature;
+    }
+    if (r->temperature < p->min)
+        p->min = r->temperature;
+    if (r->temperature > p->max)
+        p->max = r->temperature;
+    p->sum += r->temperature;
+    p->n++;
+    p->led = r->led;
+}
+
+size_t history_query(uint64_t from_ms, uint64_t to_ms, history_point_t *out, size_t max_points,
+                     history_point_t *total)
+{
+    if (total)
+        memset(total, 0, sizeof(*total));
+    if (!history_ring || max_points == 0 || to_ms < from_ms)
+        return 0;
+    if (max_points > HISTORY_MAX_POINTS)
+        max_points = HISTORY_MAX_POINTS;
+
+    uint32_t lo, hi;
+    history_window(&lo, &hi);
+
+    uint32_t t_from = history_ticks(from_ms), t_to = history_ticks(to_ms);
+    uint32_t first = history_lower(lo, hi, t_from);
+    uint32_t end = history_lower(first, hi, (uint64_t)t_to + 1);
+
+    // Equal time buckets; the +1 keeps the last bucket index below max_points
+    uint32_t width = (t_to - t_from) / max_points + 1;
+    size_t n = 0;
+    uint32_t bucket = UINT32_MAX;
+
+    for (uint32_t i = first; i < end; i++)
+    {
+        history_rec_t r = history_ring[i & history_mask];
+        uint32_t b = (r.t - t_from) / width;
+        if (b != bucket)
+        {
+            bucket = b;
+            memset(&out[n++], 0, sizeof(out[0]));
+        }
+        history_add(&out[n - 1], &r);
+        if (total)
+            history_add(total, &r);
+    }
+    return n;
+}
+
+void history_info(history_info_t *out)
+{
+    uint32_t lo, hi;
+    history_window(&lo, &hi);
+
+    memset(out, 0, sizeof(*out));
+    out->capacity = history_ring ? history_mask + 1 : 0;
+    out->pushed = hi;
+    out->count = hi - lo;
+    out->psram = history_psram;
+    if (out->count)
+    {
+        out->first_ms = (uint64_t)history_ring[lo & history_mask].t * HISTORY_TICK_MS;
+        out->last_ms = (uint64_t)history_ring[(hi - 1) & history_mask].t * HISTORY_TICK_MS;
+    }
+}
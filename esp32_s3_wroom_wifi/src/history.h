@@ -0,0 +1,81 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "uart_link.h"
+
+// Ring capacity in samples (powers of two). The large ring goes in PSRAM when the module has it and
+// CONFIG_SPIRAM is enabled; otherwise the small one is taken from internal RAM.
+#define HISTORY_PSRAM_LEN (1u << 17) // 1 MB, about 4.5 days at the master's default 3 s poll
+#define HISTORY_IRAM_LEN (1u << 12)  // 32 KB, about 3.4 hours
+
+// Sample time resolution. Times are kept in 10 ms ticks so 32 bits last 497 days of uptime.
+#define HISTORY_TICK_MS 10
+
+// Most points one query returns
+#define HISTORY_MAX_POINTS 480
+
+/**
+ * @brief One point of a query: a single sample, or the rollup of every sample in its time bucket
+ */
+typedef struct
+{
+    uint64_t t_ms;    /*!< time of the first sample in the bucket, ms since boot */
+    uint64_t sum;     /*!< sum of their temperatures, for the average */
+    uint32_t n;       /*!< samples in the bucket */
+    uint16_t min;     /*!< lowest temperature, degrees F */
+    uint16_t max;     /*!< highest temperature, degrees F */
+    uint8_t led;      /*!< LED states of the last sample */
+} history_point_t;
+
+/**
+ * @brief Ring state
+ */
+typedef struct
+{
+    uint32_t capacity; /*!< samples the ring holds */
+    uint32_t count;    /*!< samples it holds now */
+    uint32_t pushed;   /*!< samples ever pushed */
+    uint64_t first_ms; /*!< time of the oldest sample */
+    uint64_t last_ms;  /*!< time of the newest sample */
+    bool psram;        /*!< ring is in PSRAM */
+} history_info_t;
+
+/**
+ * @brief Allocates the ring, in PSRAM if there is any
+ */
+void history_init(void);
+
+/**
+ * @brief Appends a telemetry frame, stamped with the time it arrived
+ *
+ * Called from the UART link task only.
+ */
+void history_push(const link_telemetry_t *t);
+
+/**
+ * @brief Reads the samples in a time range, downsampled
+ *
+ * @param from_ms Start of the range, ms since boot
+ * @param to_ms End of the range, inclusive
+ * @param out Points, at least max_points of them
+ * @param max_points Buckets the range is divided into (at most HISTORY_MAX_POINTS)
+ * @param total Rollup of the whole range (may be NULL)
+ *
+ * The range is split into max_points equal time buckets and each non-empty one becomes a point, so a
+ * range holding fewer samples than that returns them one by one. The range is found by binary search
+ * on the sample times; only the samples inside it are read.
+ *
+ * @return Points written to out
+ */
+size_t history_query(uint64_t from_ms, uint64_t to_ms, history_point_t *out, size_t max_points,
+                     history_point_t *total);
+
+/**
+ * @brief Copies the ring state
+ */
+void history_info(history_info_t *out);
+
+#endif /* HISTORY_H */
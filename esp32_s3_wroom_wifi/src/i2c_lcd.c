@@ -1,78 +1,200 @@
 #include "i2c_lcd.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
-#include "driver/i2c.h"
+#include "esp_timer.h"
+#include "driver/i2c_master.h"
 #include "unistd.h"
 
-esp_err_t err;                  // Variable to store I2C communication errors
+// The LCD sits behind a PCF8574 I/O expander, so every HD44780 byte is two 4-bit halves, and each half
+// is two writes to the expander: one with EN high, one with EN low (the controller latches on the
+// falling edge). Four I2C bytes per character.
+//
+// The driver used to send those four bytes as their own I2C transaction per character. Now a whole
+// run, cursor command included, is built into one buffer and sent as a single transaction with the
+// i2c_master bus in asynchronous mode: the call returns once the transfer is queued, and the
+// on_trans_done callback frees its slot. At 400 kHz a character takes 90 us on the bus, well over the
+// 37 us the HD44780 needs, so characters follow each other without any wait. Only clear and return
+// home take longer (1.52 ms); those poll the busy flag through the PCF8574's read path instead of
+// sleeping.
+
+#define LCD_BYTES_PER_CHAR 4
+#define LCD_SLOT_SIZE ((1 + LCD_I2C_MAX_CHARS) * LCD_BYTES_PER_CHAR)
+
 static const char *TAG = "LCD"; // Tag for logging
 
+static i2c_master_bus_handle_t lcd_bus;
+static i2c_master_dev_handle_t lcd_dev;
+
+// Transfers complete in the order they were queued, so slots are used round-robin. lcd_free counts the
+// slots whose transfer is done.
+static uint8_t lcd_slots[LCD_I2C_SLOTS][LCD_SLOT_SIZE];
+static uint32_t lcd_next_slot = 0;
+static SemaphoreHandle_t lcd_free;
+static bool lcd_busy_flag_ok = true;
+static bool lcd_ready = false; // init done, the busy flag can be read
+
+static bool IRAM_ATTR lcd_trans_done(i2c_master_dev_handle_t dev, const i2c_master_event_data_t *evt, void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(lcd_free, &woken);
+    return woken == pdTRUE;
+}
+
 // I2C master initialization
 static esp_err_t i2c_master_init(void)
 {
-    int i2c_master_port = I2C_MASTER_NUM;
-
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,                // Set as I2C master mode
-        .sda_io_num = I2C_MASTER_SDA_IO,        // GPIO number for I2C SDA
-        .scl_io_num = I2C_MASTER_SCL_IO,        // GPIO number for I2C SCL
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,    // Enable pull-up on SDA line
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,    // Enable pull-up on SCL line
-        .master.clk_speed = I2C_MASTER_FREQ_HZ, // Set I2C clock frequency
+    i2c_master_bus_config_t bus_conf = {
+        .i2c_port = I2C_MASTER_NUM,
+        .sda_io_num = I2C_MASTER_SDA_IO,         // GPIO number for I2C SDA
+        .scl_io_num = I2C_MASTER_SCL_IO,         // GPIO number for I2C SCL
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .trans_queue_depth = LCD_I2C_SLOTS,      // non-zero: i2c_master_transmit() is asynchronous
+        .flags.enable_internal_pullup = true,    // Enable pull-ups on SDA and SCL
     };
+    esp_err_t err = i2c_new_master_bus(&bus_conf, &lcd_bus);
+    if (err != ESP_OK)
+        return err;
 
-    // Configure I2C parameters with the given configuration
-    i2c_param_config(i2c_master_port, &conf);
+    i2c_device_config_t dev_conf = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = SLAVE_ADDRESS_LCD,
+        .scl_speed_hz = I2C_MASTER_FREQ_HZ, // Set I2C clock frequency
+    };
+    err = i2c_master_bus_add_device(lcd_bus, &dev_conf, &lcd_dev);
+    if (err != ESP_OK)
+        return err;
 
-    // Install the I2C driver with the specified parameters
-    return i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+    lcd_free = xSemaphoreCreateCounting(LCD_I2C_SLOTS, LCD_I2C_SLOTS);
+    i2c_master_event_callbacks_t cbs = {
+        .on_trans_done = lcd_trans_done,
+    };
+    return i2c_master_register_event_callbacks(lcd_dev, &cbs, NULL);
 }
 
-void lcd_send_cmd(char cmd)
+// Appends one HD44780 byte (four expander writes) to buf. flags is LCD_PCF_RS for data, 0 for a command.
+static size_t lcd_pack(uint8_t *buf, uint8_t byte, uint8_t flags)
 {
-    char data_u, data_l;
-    uint8_t data_t[4];
+    uint8_t hi = byte & 0xF0, lo = (uint8_t)(byte << 4);
+    flags |= LCD_PCF_BL;
 
-    data_u = (cmd & 0xf0);        // Upper nibble of the command
-    data_l = ((cmd << 4) & 0xf0); // Lower nibble of the command
+    buf[0] = hi | flags | LCD_PCF_EN;
+    buf[1] = hi | flags;
+    buf[2] = lo | flags | LCD_PCF_EN;
+    buf[3] = lo | flags;
+    return LCD_BYTES_PER_CHAR;
+}
 
-    data_t[0] = data_u | 0x0C; // Enable (EN) = 1, Register Select (RS) = 0
-    data_t[1] = data_u | 0x08; // Enable (EN) = 0, Register Select (RS) = 0
-    data_t[2] = data_l | 0x0C; // Enable (EN) = 1, Register Select (RS) = 0
-    data_t[3] = data_l | 0x08; // Enable (EN) = 0, Register Select (RS) = 0
+// Takes the next free slot, waiting for its earlier transfer if all are queued.
+static uint8_t *lcd_slot_get(void)
+{
+    xSemaphoreTake(lcd_free, portMAX_DELAY);
+    return lcd_slots[lcd_next_slot++ % LCD_I2C_SLOTS];
+}
 
-    // Write data to the I2C device
-    err = i2c_master_write_to_device(I2C_NUM, SLAVE_ADDRESS_LCD, data_t, 4, 1000);
+static void lcd_slot_send(uint8_t *slot, size_t len)
+{
+    // Asynchronous: returns once queued, lcd_trans_done gives the slot back
+    esp_err_t err = i2c_master_transmit(lcd_dev, slot, len, I2C_MASTER_TIMEOUT_MS);
+
+    // Log an error message if there is an error in queueing the transfer
+    if (err != ESP_OK)
+    {
+        ESP_LOGI(TAG, "Error in sending to LCD: %s", esp_err_to_name(err));
+        xSemaphoreGive(lcd_free); // no callback will come for it
+    }
+}
 
-    // Log an error message if there is an error in sending the command
-    if (err != 0)
-        ESP_LOGI(TAG, "Error in sending command");
+void lcd_flush(void)
+{
+    i2c_master_bus_wait_all_done(lcd_bus, I2C_MASTER_TIMEOUT_MS);
+}
+
+// Polls the busy flag: D7 with RS = 0, RW = 1. The data pins are written high so the PCF8574's
+// quasi-bidirectional port can read what the LCD drives on them. Every transfer on lcd_dev completes
+// through lcd_trans_done, reads included, so they take a slot like any other.
+static void lcd_wait_ready(void)
+{
+    static const uint8_t hi_en[2] = {0xF0 | LCD_PCF_RW | LCD_PCF_BL, 0xF0 | LCD_PCF_RW | LCD_PCF_BL | LCD_PCF_EN};
+    static const uint8_t lo_pulse[3] = {0xF0 | LCD_PCF_RW | LCD_PCF_BL, 0xF0 | LCD_PCF_RW | LCD_PCF_BL | LCD_PCF_EN,
+                                        0xF0 | LCD_PCF_RW | LCD_PCF_BL};
+    static uint8_t port;
+
+    if (!lcd_busy_flag_ok)
+    {
+        lcd_flush();
+        usleep(LCD_BUSY_TIMEOUT_US);
+        return;
+    }
+
+    int64_t deadline = esp_timer_get_time() + LCD_BUSY_TIMEOUT_US;
+    for (;;)
+    {
+        // EN high on the upper half and read it, then clock out the lower half
+        uint8_t *slot = lcd_slot_get();
+        memcpy(slot, hi_en, sizeof(hi_en));
+        if (i2c_master_transmit_receive(lcd_dev, slot, sizeof(hi_en), &port, 1, I2C_MASTER_TIMEOUT_MS) != ESP_OK)
+            xSemaphoreGive(lcd_free);
+        slot = lcd_slot_get();
+        memcpy(slot, lo_pulse, sizeof(lo_pulse));
+        lcd_slot_send(slot, sizeof(lo_pulse));
+        lcd_flush();
+
+        if (!(port & 0x80))
+            return;
+        if (esp_timer_get_time() > deadline)
+        {
+            // Never saw ready: RW is probably not wired. Stop trying and just wait from now on.
+            ESP_LOGI(TAG, "Busy flag not readable, using fixed delays");
+            lcd_busy_flag_ok = false;
+            return;
+        }
+    }
+}
+
+void lcd_send_cmd(char cmd)
+{
+    uint8_t *slot = lcd_slot_get();
+    lcd_slot_send(slot, lcd_pack(slot, (uint8_t)cmd, 0));
+
+    if (lcd_ready && (cmd == LCD_CMD_CLEAR_DISPLAY || cmd == LCD_CMD_RETURN_HOME))
+        lcd_wait_ready();
 }
 
 void lcd_send_data(char data)
 {
-    char data_u, data_l;
-    uint8_t data_t[4];
+    uint8_t *slot = lcd_slot_get();
+    lcd_slot_send(slot, lcd_pack(slot, (uint8_t)data, LCD_PCF_RS));
+}
 
-    data_u = (data & 0xf0);        // Upper nibble of the data
-    data_l = ((data << 4) & 0xf0); // Lower nibble of the data
+void lcd_write_at(int row, int col, const char *str, size_t len)
+{
+    uint8_t *slot = lcd_slot_get();
+    uint8_t pos = (uint8_t)(LCD_CMD_SET_CURSOR | (row ? 0x40 : 0x00) | col);
+    size_t n = lcd_pack(slot, pos, 0);
 
-    data_t[0] = data_u | 0x0D; // Enable (EN) = 1, Register Select (RS) = 1
-    data_t[1] = data_u | 0x09; // Enable (EN) = 0, Register Select (RS) = 1
-    data_t[2] = data_l | 0x0D; // Enable (EN) = 1, Register Select (RS) = 1
-    data_t[3] = data_l | 0x09; // Enable (EN) = 0, Register Select (RS) = 1
+    if (len > LCD_I2C_MAX_CHARS)
+        len = LCD_I2C_MAX_CHARS;
+    for (size_t i = 0; i < len; i++)
+        n += lcd_pack(slot + n, (uint8_t)str[i], LCD_PCF_RS);
+    lcd_slot_send(slot, n);
+}
 
-    // Write data to the I2C device
-    err = i2c_master_write_to_device(I2C_NUM, SLAVE_ADDRESS_LCD, data_t, 4, 1000);
+void lcd_write_glyph(int glyph, const uint8_t rows[8])
+{
+    uint8_t *slot = lcd_slot_get();
+    size_t n = lcd_pack(slot, (uint8_t)(LCD_CMD_SET_CGRAM | (glyph & 7) << 3), 0);
 
-    // Log an error message if there is an error in sending the data
-    if (err != 0)
-        ESP_LOGI(TAG, "Error in sending data");
+    for (int i = 0; i < 8; i++)
+        n += lcd_pack(slot + n, rows[i], LCD_PCF_RS);
+    lcd_slot_send(slot, n);
 }
 
 void lcd_clear(void)
 {
-    lcd_send_cmd(LCD_CMD_CLEAR_DISPLAY); // Clear display command
-    usleep(5000);                        // Wait for the command to execute
+    lcd_send_cmd(LCD_CMD_CLEAR_DISPLAY); // Clear display command, waits for the busy flag
 }
 
 void lcd_put_cursor(int row, int col)
@@ -92,36 +214,51 @@ void lcd_put_cursor(int row, int col)
 
 void lcd_init(void)
 {
-    i2c_master_init(); // Initialize I2C master interface
+    ESP_ERROR_CHECK(i2c_master_init()); // Initialize I2C master interface
 
-    // 4-bit initialization sequence
+    // 4-bit initialization sequence. The busy flag is not read until it is complete, so these waits
+    // stay fixed; each one is timed from when the command has actually left the bus.
     usleep(50000); // Wait for >40ms
     lcd_send_cmd(LCD_CMD_INIT_8_BIT_MODE);
+    lcd_flush();
     usleep(5000); // Wait for >4.1ms
     lcd_send_cmd(LCD_CMD_INIT_8_BIT_MODE);
+    lcd_flush();
     usleep(200); // Wait for >100us
     lcd_send_cmd(LCD_CMD_INIT_8_BIT_MODE);
+    lcd_flush();
     usleep(10000);
     lcd_send_cmd(LCD_CMD_INIT_4_BIT_MODE); // Set 4-bit mode
+    lcd_flush();
     usleep(10000);
 
     // Display initialization
     lcd_send_cmd(LCD_CMD_FUNCTION_SET); // Function set: 4-bit mode, 2-line display, 5x8 characters
+    lcd_flush();
     usleep(1000);
     lcd_send_cmd(LCD_CMD_DISPLAY_OFF); // Display off
+    lcd_flush();
     usleep(1000);
     lcd_send_cmd(LCD_CMD_CLEAR_DISPLAY); // Clear display
-    usleep(1000);
+    lcd_flush();
+    usleep(2000);
     lcd_send_cmd(LCD_CMD_ENTRY_MODE_SET); // Entry mode set: increment cursor, no shift
+    lcd_flush();
     usleep(1000);
     lcd_send_cmd(LCD_CMD_DISPLAY_ON); // Display on, cursor off, blink off
-    usleep(1000);
+    lcd_flush();
+
+    lcd_ready = true;
 }
 
 void lcd_send_string(const char *str)
 {
     while (*str)
     {
-        lcd_send_data(*str++);
+        uint8_t *slot = lcd_slot_get();
+        size_t n = 0;
+        for (int i = 0; i < LCD_I2C_MAX_CHARS && *str; i++)
+            n += lcd_pack(slot + n, (uint8_t)*str++, LCD_PCF_RS);
+        lcd_slot_send(slot, n);
     }
 }
@@ -1,6 +1,10 @@
 #ifndef I2C_LCD_H
 #define I2C_LCD_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/gpio.h"
+
 // I2C address of the LCD (change according to your setup)
 #define SLAVE_ADDRESS_LCD 0x27
 
@@ -13,20 +17,29 @@
 // I2C master port number (number of I2C peripheral interfaces available depends on the chip)
 #define I2C_MASTER_NUM 0
 
-// I2C master clock frequency
+// I2C master clock frequency. The PCF8574 is rated for 100 kHz, but backpacks run reliably at 400 kHz.
+// Going faster would not help anyway: each character is four bytes on the bus, 90 us at 400 kHz, and
+// at around 1 MHz that would drop below the 37 us the HD44780 needs to execute it.
 #define I2C_MASTER_FREQ_HZ 400000
 
-// I2C master doesn't need buffer for transmission
-#define I2C_MASTER_TX_BUF_DISABLE 0
-
-// I2C master doesn't need buffer for reception
-#define I2C_MASTER_RX_BUF_DISABLE 0
-
 // Timeout for I2C master in milliseconds
 #define I2C_MASTER_TIMEOUT_MS 1000
 
-// Define the I2C number to be used
-#define I2C_NUM I2C_NUM_0
+// Transactions that can be queued on the bus at once (asynchronous writes)
+#define LCD_I2C_SLOTS 4
+
+// Longest run lcd_write_at() sends as one transaction (a full row plus the cursor command)
+#define LCD_I2C_MAX_CHARS 40
+
+// Longest wait for the busy flag, in microseconds. A clear takes 1.52 ms; a backpack without the RW
+// line wired always reads busy and falls back to this.
+#define LCD_BUSY_TIMEOUT_US 3000
+
+// PCF8574 port bits on the usual backpack: P0 = RS, P1 = RW, P2 = EN, P3 = backlight, P4..P7 = D4..D7
+#define LCD_PCF_RS 0x01
+#define LCD_PCF_RW 0x02
+#define LCD_PCF_EN 0x04
+#define LCD_PCF_BL 0x08
 
 // LCD command definitions
 #define LCD_CMD_CLEAR_DISPLAY 0x01
@@ -35,14 +48,16 @@
 #define LCD_CMD_DISPLAY_ON 0x0C
 #define LCD_CMD_DISPLAY_OFF 0x08
 #define LCD_CMD_FUNCTION_SET 0x28
+#define LCD_CMD_SET_CGRAM 0x40 // | glyph << 3: user glyph bitmaps
 #define LCD_CMD_SET_CURSOR 0x80
+#define LCD_CMD_SHIFT_LEFT 0x18 // cursor/display shift: shift the display, to the left
 #define LCD_CMD_INIT_8_BIT_MODE 0x30
 #define LCD_CMD_INIT_4_BIT_MODE 0x20
 
 /**
  * @brief Initializes the LCD
  *
- * This function sets up the LCD for use, initializing the required configurations.
+ * This function sets up the I2C bus and the LCD, initializing the required configurations.
  */
 void lcd_init(void);
 
@@ -51,7 +66,8 @@ void lcd_init(void);
  *
  * @param cmd The command to send to the LCD
  *
- * This function sends a command to the LCD to perform various control operations.
+ * This function sends a command to the LCD to perform various control operations. Clear and return
+ * home wait for the busy flag before returning.
  */
 void lcd_send_cmd(char cmd);
 
@@ -69,10 +85,35 @@ void lcd_send_data(char data);
  *
  * @param str The string to send to the LCD
  *
- * This function sends a null-terminated string to the LCD to be displayed.
+ * This function sends a null-terminated string to the LCD to be displayed, as one I2C transaction
+ * per LCD_I2C_MAX_CHARS characters.
  */
 void lcd_send_string(const char *str);
 
+/**
+ * @brief Writes characters at a position in one I2C transaction
+ *
+ * @param row The row number (0 or 1)
+ * @param col The column number in the line memory (0-39; 0-15 are visible when not shifted)
+ * @param str The characters to write, not necessarily null-terminated
+ * @param len How many to write (at most LCD_I2C_MAX_CHARS)
+ *
+ * The cursor command and every character are packed into one transfer, queued on the bus and
+ * completed asynchronously. Returns as soon as a transaction slot is free.
+ */
+void lcd_write_at(int row, int col, const char *str, size_t len);
+
+/**
+ * @brief Loads a user glyph in one I2C transaction
+ *
+ * @param glyph CGRAM slot (0-7), shown by character codes glyph and glyph + 8
+ * @param rows 8 rows, top first, pixels in bits 4..0
+ *
+ * Characters already on the panel that use the glyph change with it. Leaves the address counter in
+ * CGRAM, so the next write must set the cursor first (lcd_write_at() does).
+ */
+void lcd_write_glyph(int glyph, const uint8_t rows[8]);
+
 /**
  * @brief Sets the cursor position on the LCD
  *
@@ -90,4 +131,9 @@ void lcd_put_cursor(int row, int col);
  */
 void lcd_clear(void);
 
+/**
+ * @brief Waits until every queued transaction has reached the LCD
+ */
+void lcd_flush(void);
+
 #endif /* I2C_LCD_H */
@@ -0,0 +1,242 @@
+#include "lcd_render.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "i2c_lcd.h"
+
+// Drawing on the panel is slow next to an HTTP request: even batched (i2c_lcd.c), a full screen is
+// about 3 ms on the bus. The HTTP handlers and the UART link used to draw inline, blocking for tens of
+// milliseconds each time. Now they hand a whole frame to this task and return.
+//
+// The hand-off is a one-slot mailbox (xQueueOverwrite): a frame submitted while an earlier one is still
+// waiting replaces it, so a burst of updates costs one redraw. The task keeps a shadow copy of the
+// controller's DDRAM and only writes the cells that differ, one I2C transaction per run of changed
+// cells. The panel is never cleared.
+//
+// Marquee: each DDRAM line is LCD_DDRAM_COLS wide and the panel shows LCD_COLS of it. A long message
+// is written once into both full lines, then an esp_timer wakes the task every LCD_MARQUEE_MS to
+// shift the display one column left. The controller wraps each line around, so the text loops for
+// one command byte per step and nothing is rewritten. The next normal frame stops the timer and
+// returns the display home.
+//
+// Glyphs: the 8 user glyphs have their own one-slot mailbox, so a text frame never drops a glyph
+// update or the other way round. The task keeps a shadow of CGRAM too and loads only the glyphs whose
+// bitmap changed, 9 bytes each. A character showing a glyph follows its bitmap, so a glyph update
+// needs no DDRAM write at all.
+
+#define LCD_RENDER_STACK 3072
+#define LCD_RENDER_PRIO 5
+#define LCD_RUN_GAP 1 // unchanged cells rewritten rather than starting a new run
+
+typedef struct
+{
+    bool marquee; // cells are full DDRAM lines to scroll
+    char cells[LCD_ROWS][LCD_DDRAM_COLS];
+} lcd_frame_t;
+
+static const char *TAG = "LCD_RENDER";
+
+typedef struct
+{
+    uint8_t rows[LCD_GLYPHS][LCD_GLYPH_ROWS];
+} lcd_glyphs_t;
+
+static QueueHandle_t lcd_mailbox;
+static QueueHandle_t lcd_glyph_mailbox;
+static TaskHandle_t lcd_task;
+static esp_timer_handle_t lcd_marquee_timer;
+static char lcd_shadow[LCD_ROWS][LCD_DDRAM_COLS]; // the controller's DDRAM, render task only
+static uint8_t lcd_cgram[LCD_GLYPHS][LCD_GLYPH_ROWS]; // the controller's CGRAM, render task only
+static bool lcd_cgram_valid[LCD_GLYPHS];               // CGRAM is undefined after power-up
+static bool lcd_shifted = false;                  // display shift is away from home
+static volatile uint32_t lcd_steps_due = 0;       // set by the marquee timer
+static lcd_render_stats_t lcd_stats;
+
+// Writes the changed cells of one row, one lcd_write_at() transaction per run. Runs separated by a
+// single unchanged cell are merged: rewriting that cell costs four bus bytes, a new transaction with
+// its cursor command costs more.
+static void lcd_render_row(int row, const char *want, int cols)
+{
+    char *have = lcd_shadow[row];
+    int col = 0;
+
+    while (col < cols)
+    {
+        if (have[col] == want[col])
+        {
+            col++;
+            continue;
+        }
+        int start = col, end = col + 1; // [start, end) differs
+        for (col = end; col < cols; col++)
+        {
+            if (have[col] != want[col])
+                end = col + 1;
+            else if (col - end >= LCD_RUN_GAP)
+                break;
+        }
+        lcd_write_at(row, start, want + start, end - start);
+        memcpy(have + start, want + start, end - start);
+        lcd_stats.cells += end - start;
+        col = end;
+    }
+}
+
+static void lcd_marquee_tick(void *arg)
+{
+    (void)arg;
+    lcd_steps_due = 1;
+    xTaskNotifyGive(lcd_task);
+}
+
+static void lcd_render_load_glyphs(const lcd_glyphs_t *set)
+{
+    for (int g = 0; g < LCD_GLYPHS; g++)
+    {
+        if (lcd_cgram_valid[g] && memcmp(lcd_cgram[g], set->rows[g], LCD_GLYPH_ROWS) == 0)
+            continue;
+        lcd_write_glyph(g, set->rows[g]);
+        memcpy(lcd_cgram[g], set->rows[g], LCD_GLYPH_ROWS);
+        lcd_cgram_valid[g] = true;
+        lcd_stats.glyphs++;
+    }
+}
+
+static void lcd_render_frame(const lcd_frame_t *frame)
+{
+    int64_t t0 = esp_timer_get_time();
+
+    esp_timer_stop(lcd_marquee_timer); // fails harmlessly if it was not running
+    lcd_steps_due = 0;
+    if (lcd_shifted)
+    {
+        lcd_send_cmd(LCD_CMD_RETURN_HOME); // undoes the shift, waits for the busy flag
+        lcd_shifted = false;
+    }
+
+    // A normal frame only touches the visible columns; the rest of DDRAM keeps whatever is there
+    int cols = frame->marquee ? LCD_DDRAM_COLS : LCD_COLS;
+    for (int row = 0; row < LCD_ROWS; row++)
+        lcd_render_row(row, frame->cells[row], cols);
+    lcd_flush(); // so last_us is the time until the panel shows it
+
+    lcd_stats.last_us = (uint32_t)(esp_timer_get_time() - t0);
+    lcd_stats.renders++;
+
+    if (frame->marquee)
+        esp_timer_start_periodic(lcd_marquee_timer, LCD_MARQUEE_MS * 1000);
+}
+
+static void lcd_render_task(void *arg)
+{
+    (void)arg;
+    lcd_frame_t frame;
+    lcd_glyphs_t glyphs;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Glyphs first, so a frame that uses them shows the new ones from the start
+        if (xQueueReceive(lcd_glyph_mailbox, &glyphs, 0) == pdTRUE)
+            lcd_render_load_glyphs(&glyphs);
+        if (xQueueReceive(lcd_mailbox, &frame, 0) == pdTRUE)
+            lcd_render_frame(&frame);
+
+        // One shift per wake-up: a step missed while drawing is dropped, not made up later
+        if (lcd_steps_due)
+        {
+            lcd_steps_due = 0;
+            lcd_send_cmd(LCD_CMD_SHIFT_LEFT);
+            lcd_shifted = true;
+            lcd_stats.shifts++;
+        }
+    }
+}
+
+void lcd_render_start(void)
+{
+    // lcd_init() leaves the panel cleared
+    memset(lcd_shadow, ' ', sizeof(lcd_shadow));
+
+    lcd_mailbox = xQueueCreate(1, sizeof(lcd_frame_t));
+    lcd_glyph_mailbox = xQueueCreate(1, sizeof(lcd_glyphs_t));
+    xTaskCreatePinnedToCore(lcd_render_task, "lcd_render", LCD_RENDER_STACK, NULL, LCD_RENDER_PRIO, &lcd_task,
+                            LCD_RENDER_CORE);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = lcd_marquee_tick,
+        .name = "lcd_marquee",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &lcd_marquee_timer));
+    ESP_LOGI(TAG, "render task on core %d", LCD_RENDER_CORE);
+}
+
+static void lcd_fill_row(char *row, const char *text, size_t n, int cols)
+{
+    if (n > (size_t)cols)
+        n = cols;
+    if (n)
+        memcpy(row, text, n);
+    memset(row + n, ' ', cols - n);
+}
+
+static void lcd_submit(const lcd_frame_t *frame)
+{
+    if (uxQueueMessagesWaiting(lcd_mailbox))
+        lcd_stats.coalesced++;
+    lcd_stats.requests++;
+    xQueueOverwrite(lcd_mailbox, frame);
+    xTaskNotifyGive(lcd_task);
+}
+
+void lcd_render_lines(const char *l1, const char *l2)
+{
+    lcd_frame_t frame = {.marquee = false};
+    lcd_fill_row(frame.cells[0], l1, l1 ? strlen(l1) : 0, LCD_COLS);
+    lcd_fill_row(frame.cells[1], l2, l2 ? strlen(l2) : 0, LCD_COLS);
+    lcd_submit(&frame);
+}
+
+uint32_t lcd_render_marquee(const char *text)
+{
+    lcd_frame_t frame = {.marquee = true};
+    size_t len = strlen(text);
+    size_t split = len;
+
+    // The top line takes as many whole words as fit in a DDRAM line, the bottom line the rest
+    if (len > LCD_DDRAM_COLS)
+    {
+        split = LCD_DDRAM_COLS;
+        for (size_t i = LCD_DDRAM_COLS; i > 0; i--)
+        {
+            if (text[i] == ' ')
+            {
+                split = i;
+                break;
+            }
+        }
+    }
+    lcd_fill_row(frame.cells[0], text, split, LCD_DDRAM_COLS);
+    const char *rest = text + split + (text[split] == ' ');
+    lcd_fill_row(frame.cells[1], rest, strlen(rest), LCD_DDRAM_COLS);
+    lcd_submit(&frame);
+
+    return LCD_DDRAM_COLS * LCD_MARQUEE_MS;
+}
+
+void lcd_render_glyphs(const uint8_t glyphs[LCD_GLYPHS][LCD_GLYPH_ROWS])
+{
+    lcd_glyphs_t set;
+    memcpy(set.rows, glyphs, sizeof(set.rows));
+    xQueueOverwrite(lcd_glyph_mailbox, &set);
+    xTaskNotifyGive(lcd_task);
+}
+
+void lcd_render_stats(lcd_render_stats_t *out)
+{
+    *out = lcd_stats; // counters only; a torn read is off by one at worst
+}
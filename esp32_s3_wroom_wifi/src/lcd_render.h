@@ -0,0 +1,81 @@
+#ifndef LCD_RENDER_H
+#define LCD_RENDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Panel geometry
+#define LCD_ROWS 2
+#define LCD_COLS 16
+#define LCD_DDRAM_COLS 40 // each line of the controller's memory; the panel shows LCD_COLS of it
+
+// User glyphs (CGRAM): 8 of them, 8 rows each
+#define LCD_GLYPHS 8
+#define LCD_GLYPH_ROWS 8
+
+// Marquee scroll step
+#define LCD_MARQUEE_MS 350
+
+// Core the render task is pinned to (Wi-Fi runs on core 0)
+#define LCD_RENDER_CORE 1
+
+/**
+ * @brief Render counters
+ */
+typedef struct
+{
+    uint32_t requests;  /*!< frames submitted */
+    uint32_t coalesced; /*!< frames replaced by a newer one before they were drawn */
+    uint32_t renders;   /*!< frames drawn */
+    uint32_t cells;     /*!< characters written to the panel */
+    uint32_t shifts;    /*!< marquee scroll steps */
+    uint32_t glyphs;    /*!< user glyphs loaded */
+    uint32_t last_us;   /*!< time the last redraw took */
+} lcd_render_stats_t;
+
+/**
+ * @brief Starts the render task
+ *
+ * lcd_init() must have run. From here on only the render task talks to the panel.
+ */
+void lcd_render_start(void);
+
+/**
+ * @brief Submits a frame to draw
+ *
+ * @param l1 Top line, padded or cut to LCD_COLS
+ * @param l2 Bottom line, padded or cut to LCD_COLS
+ *
+ * Returns at once. If an earlier frame has not been drawn yet, this one replaces it.
+ */
+void lcd_render_lines(const char *l1, const char *l2);
+
+/**
+ * @brief Submits a message too long for the panel, to scroll
+ *
+ * @param text Up to 2 * LCD_DDRAM_COLS characters, split between the lines at a word boundary
+ *
+ * The message is loaded into the controller's full line memory and scrolled with its display shift
+ * command until the next frame is submitted. Returns at once, like lcd_render_lines().
+ *
+ * @return Time one full scroll cycle takes, in milliseconds
+ */
+uint32_t lcd_render_marquee(const char *text);
+
+/**
+ * @brief Submits the user glyph bitmaps
+ *
+ * @param glyphs LCD_GLYPHS bitmaps of LCD_GLYPH_ROWS rows, top first, pixels in bits 4..0
+ *
+ * Only glyphs that differ from what the controller already holds are loaded. Characters using them
+ * (codes 0x08..0x0F in a frame) change on the panel without being rewritten. Returns at once; a set
+ * not loaded yet is replaced by a newer one, independently of the frame mailbox.
+ */
+void lcd_render_glyphs(const uint8_t glyphs[LCD_GLYPHS][LCD_GLYPH_ROWS]);
+
+/**
+ * @brief Copies the render counters
+ */
+void lcd_render_stats(lcd_render_stats_t *out);
+
+#endif /* LCD_RENDER_H */
@@ -1,8 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
@@ -10,10 +12,15 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 #include "esp_http_server.h"
+#include "esp_http_client.h"
 #include "nvs_flash.h"
 #include "cJSON.h"
 #include "i2c_lcd.h"
-#include "driver/uart.h"
+#include "lcd_render.h"
+#include "uart_link.h"
+#include "history.h"
+#include "dashboard.h"
+#include "sparkline.h"
 #include "driver/gpio.h"
 
 #ifndef MIN
@@ -25,26 +32,47 @@
 #define WIFI_SSID "MY_WIFI"
 #define WIFI_PASS "MY_PASSWORD"
 
+// The Pico 2W, for LED commands from the dashboard (everything else comes over the UART link)
+#define PICO_URL "http://your_local_ip"
+#define PICO_TIMEOUT_MS 2000
+
 #define SLAVE_IN 4
 #define SLAVE_OUT 5
 #define CLOCK_OUT 6
-#define MASTER_IN 7
-#define MASTER_LOOP 9
+#define MASTER_IN 7   // request line from the master, owned by uart_link (LINK_REQ_IO)
+#define MASTER_LOOP 9 // ready/busy line to the master, owned by uart_link (LINK_READY_IO)
+
+#define TEXT_HOLD_MS 5000  // text stays on the display this long before telemetry redraws it
+#define LINK_FRESH_MS 2000 // telemetry this recent makes the HTTP temperature push redundant
+
+// HTTP server. lwIP has CONFIG_LWIP_MAX_SOCKETS (16) sockets and the server keeps 3 for itself, so 13
+// clients: the master's keep-alive connection, up to DASH_SSE_CLIENTS event streams, and the rest for
+// page loads and API calls.
+#define HTTP_MAX_SOCKETS 13
+#define HTTP_BACKLOG 8         // connections waiting in accept() during a burst
+#define HTTP_STACK 8192        // cJSON and the status response run on it
+#define HTTP_PRIO 6            // above the render task, below the UART link
+#define HTTP_CORE 1            // off the Wi-Fi core
+#define HTTP_TIMEOUT_S 3       // a stalled client holds a socket at most this long
+#define HTTP_MAX_URI_HANDLERS 16
+#define HTTP_WORKERS 2         // tasks running async requests
+#define HTTP_WORKER_STACK 6144 // cJSON, or a history query and its float formatting
+#define HTTP_ASYNC_QUEUE 4
+
+#define HISTORY_POINTS_DEFAULT 120 // /api/history points when the query does not say
 
 static const char *TAG = "ESP32_HTTP";
 
 /* ===================== LCD HELPERS ===================== */
 
+// Queues the frame for the render task (lcd_render.c) and returns at once
 static void lcd_show_two_lines(const char *l1, const char *l2)
 {
-    lcd_clear();
-    lcd_put_cursor(0, 0);
-    lcd_send_string(l1);
-    lcd_put_cursor(1, 0);
-    lcd_send_string(l2);
+    lcd_render_lines(l1, l2);
 }
 
-static void lcd_show_wrapped_text(const char *text)
+// Returns how long the text should be held on the display, in milliseconds
+static uint32_t lcd_show_wrapped_text(const char *text)
 {
     char l1[17] = {0};
     char l2[17] = {0};
@@ -67,11 +95,149 @@ static void lcd_show_wrapped_text(const char *text)
             }
         }
 
+        // Does not fit on two lines: scroll it instead, held for at least one full pass
+        const char *rest = text + ((split < len) ? split + 1 : split);
+        if (strlen(rest) > 16)
+        {
+            uint32_t cycle_ms = lcd_render_marquee(text);
+            return cycle_ms > TEXT_HOLD_MS ? cycle_ms : TEXT_HOLD_MS;
+        }
+
         strncpy(l1, text, split);
-        strncpy(l2, text + ((split < len) ? split + 1 : split), 16);
+        strncpy(l2, rest, 16);
     }
 
     lcd_show_two_lines(l1, l2);
+    return TEXT_HOLD_MS;
+}
+
+/* ===================== SPARKLINE ===================== */
+
+// The temperature screens end in a sparkline of the last 20 minutes, drawn in the 8 user glyphs
+// (sparkline.h). The characters are written once with the rest of the line; after that each completed
+// column only reloads the glyphs that changed, usually one. Telemetry and the HTTP temperature push
+// both feed it, from different tasks.
+#define SPARK_TEXT_COLS (LCD_COLS - SPARK_GLYPHS) // what is left of the line for the reading
+
+static sparkline_t spark;
+static portMUX_TYPE spark_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void spark_add(uint16_t temp)
+{
+    uint8_t glyphs[SPARK_GLYPHS][SPARK_GLYPH_ROWS];
+
+    taskENTER_CRITICAL(&spark_mux);
+    bool closed = sparkline_add(&spark, temp, esp_timer_get_time());
+    if (closed)
+        sparkline_glyphs(&spark, glyphs);
+    taskEXIT_CRITICAL(&spark_mux);
+
+    if (closed)
+        lcd_render_glyphs(glyphs);
+}
+
+// Fills line with text, cut or padded to SPARK_TEXT_COLS, followed by the sparkline characters
+static void spark_line(char line[LCD_COLS + 1], const char *text)
+{
+    snprintf(line, SPARK_TEXT_COLS + 1, "%-*s", SPARK_TEXT_COLS, text);
+    for (int g = 0; g < SPARK_GLYPHS; g++)
+        line[SPARK_TEXT_COLS + g] = SPARK_CHAR(g);
+    line[LCD_COLS] = '\0';
+}
+
+static void spark_init(void)
+{
+    uint8_t glyphs[SPARK_GLYPHS][SPARK_GLYPH_ROWS];
+
+    // CGRAM holds garbage after power-up; start from an empty strip
+    sparkline_init(&spark);
+    sparkline_glyphs(&spark, glyphs);
+    lcd_render_glyphs(glyphs);
+}
+
+/* ===================== RENDER PACING ===================== */
+
+// The master paces its display updates to how long a redraw takes here. Every update response carries
+// X-Render-Ms, the time the render task's last redraw took, rounded up. The handler itself no longer
+// waits for the panel.
+static void render_ms_hdr(char *buf, size_t len)
+{
+    lcd_render_stats_t rs;
+    lcd_render_stats(&rs);
+    snprintf(buf, len, "%lu", (unsigned long)((rs.last_us + 999) / 1000));
+}
+
+/* ===================== UART LINK ===================== */
+
+// Telemetry arrives at the master's SPI poll rate, far faster than the display can change. It is only
+// redrawn when the temperature or the LEDs change, and not while a text is being held.
+static volatile int64_t text_hold_until = 0;
+static bool telemetry_shown = false;
+static uint16_t shown_temp;
+static uint8_t shown_led;
+
+static void text_hold(uint32_t ms)
+{
+    text_hold_until = esp_timer_get_time() + ms * 1000LL;
+    telemetry_shown = false;
+}
+
+static void on_link_telemetry(const link_telemetry_t *t)
+{
+    history_push(t);
+    dashboard_publish();
+    spark_add(t->temperature);
+
+    if (esp_timer_get_time() < text_hold_until)
+        return;
+    if (telemetry_shown && t->temperature == shown_temp && t->led == shown_led)
+        return;
+
+    char text[LCD_COLS + 1], l1[LCD_COLS + 1], l2[LCD_COLS + 1];
+    snprintf(text, sizeof(text), "%uF %dC", t->temperature, ((int)t->temperature - 32) * 5 / 9);
+    spark_line(l1, text);
+    snprintf(l2, sizeof(l2), "LED %c%c%c %s",
+             (t->led & 1) ? 'G' : '-', (t->led & 2) ? 'Y' : '-', (t->led & 4) ? 'R' : '-',
+             (t->led & 8) ? "ON" : "OFF");
+    lcd_show_two_lines(l1, l2);
+
+    shown_temp = t->temperature;
+    shown_led = t->led;
+    telemetry_shown = true;
+}
+
+static bool link_fresh(void)
+{
+    link_telemetry_t t;
+    return uart_link_telemetry(&t) && esp_timer_get_time() - t.rx_us < LINK_FRESH_MS * 1000LL;
+}
+
+/* ===================== GPIO ===================== */
+
+// SLAVE_IN is the Pico slave's on/off control line. Its ISR only notifies slave_in_task, which does
+// the rest at task level.
+static TaskHandle_t slave_in_handle;
+static volatile uint32_t slave_in_edges = 0;
+static volatile int slave_in_level = 0;
+
+static void IRAM_ATTR slave_in_isr(void *arg)
+{
+    (void)arg;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(slave_in_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void slave_in_task(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        uint32_t n = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        slave_in_edges += n;
+        slave_in_level = gpio_get_level(SLAVE_IN);
+        ESP_LOGI(TAG, "SLAVE_IN %s", slave_in_level ? "on" : "off");
+    }
 }
 
 /* ===================== HTTP BODY RECV ===================== */
@@ -133,15 +299,14 @@ static esp_err_t text_post_handler(httpd_req_t *req)
     }
 
     ESP_LOGI(TAG, "TEXT RECEIVED: \"%s\"", txt->valuestring);
-    lcd_show_wrapped_text(txt->valuestring);
+    text_hold(lcd_show_wrapped_text(txt->valuestring));
 
     cJSON_Delete(json);
+    char render_ms[12];
+    render_ms_hdr(render_ms, sizeof(render_ms));
+    httpd_resp_set_hdr(req, "X-Render-Ms", render_ms);
     httpd_resp_sendstr(req, "{\"ok\":true}");
 
-    gpio_set_level(MASTER_LOOP, 1);
-    vTaskDelay(pdMS_TO_TICKS(20));
-    gpio_set_level(MASTER_LOOP, 0);
-
     return ESP_OK;
 }
 
@@ -174,64 +339,403 @@ static esp_err_t cmd_post_handler(httpd_req_t *req)
         return ESP_OK;
     }
 
-    char l1[17], l2[17];
-    snprintf(l1, sizeof(l1), "%dF", tf->valueint);
+    char text[LCD_COLS + 1], l1[LCD_COLS + 1], l2[LCD_COLS + 1];
+    snprintf(text, sizeof(text), "%dF", tf->valueint);
+    spark_line(l1, text);
     snprintf(l2, sizeof(l2), "%dC", tc->valueint);
 
-    lcd_show_two_lines(l1, l2);
+    // With the UART link up, the display and the sparkline already follow the telemetry frames
+    if (!link_fresh())
+    {
+        if (tf->valueint >= 0 && tf->valueint < SPARK_NONE)
+            spark_add((uint16_t)tf->valueint);
+        lcd_show_two_lines(l1, l2);
+    }
 
     cJSON_Delete(json);
+    char render_ms[12];
+    render_ms_hdr(render_ms, sizeof(render_ms));
+    httpd_resp_set_hdr(req, "X-Render-Ms", render_ms);
     httpd_resp_sendstr(req, "{\"ok\":true}");
     return ESP_OK;
 }
 
-static esp_err_t status_get_handler(httpd_req_t *req)
+// POST /api/control from the dashboard, passed on to the Pico 2W as it is. The only request that
+// reaches the Pico for a browser, and only when someone clicks.
+static esp_err_t control_post_handler(httpd_req_t *req)
 {
-    char resp[256];
+    char buf[128];
+
+    if (recv_body(req, buf, sizeof(buf)) != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body error");
+        return ESP_OK;
+    }
 
-    snprintf(resp, sizeof(resp),
-             "{"
-             "\"status\":\"ok\","
-             "\"uptime_ms\":%llu,"
-             "\"free_heap\":%lu"
-             "}",
-             esp_timer_get_time() / 1000,
-             esp_get_free_heap_size());
+    esp_http_client_config_t cfg = {
+        .url = PICO_URL "/api/control",
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = PICO_TIMEOUT_MS,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+
+    char resp[128];
+    int status = 0, len = 0;
+    int body_len = strlen(buf);
+    if (esp_http_client_open(client, body_len) == ESP_OK)
+    {
+        if (esp_http_client_write(client, buf, body_len) == body_len && esp_http_client_fetch_headers(client) >= 0)
+        {
+            status = esp_http_client_get_status_code(client);
+            len = esp_http_client_read_response(client, resp, sizeof(resp) - 1);
+        }
+        esp_http_client_close(client);
+    }
+    esp_http_client_cleanup(client);
+
+    if (status == 0 || len < 0)
+    {
+        ESP_LOGW(TAG, "Pico 2W did not answer /api/control");
+        httpd_resp_set_status(req, "504 Gateway Timeout");
+        httpd_resp_sendstr(req, "{\"error\":\"Pico unreachable\"}");
+        return ESP_OK;
+    }
 
+    // The Pico answers 202 once the command is queued, 400 for a body it did not accept and 503 while
+    // its command queue is full. Any 2xx goes back as it is; anything else is its problem, not ours.
+    char status_line[24];
+    if (status >= 200 && status < 300)
+        snprintf(status_line, sizeof(status_line), "%d %s", status,
+                 status == 200 ? "OK" : status == 202 ? "Accepted" : status == 204 ? "No Content" : "Success");
+    else
+        snprintf(status_line, sizeof(status_line), "%s",
+                 status == 400   ? "400 Bad Request"
+                 : status == 503 ? "503 Service Unavailable"
+                                 : "502 Bad Gateway");
+    httpd_resp_set_status(req, status_line);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
+    httpd_resp_send(req, resp, len);
+    return ESP_OK;
+}
+
+// GET /api/history?from=<ms>&to=<ms>&points=N, or ?last=<ms>&points=N for a window ending now. Times
+// are ms since the ESP32 booted; "now_ms" in the response maps them to the client's clock. Each point is
+// [t_ms, samples, avg, min, max, led] for one time bucket, and "rollup" covers the whole range.
+static uint64_t query_u64(const char *qs, const char *key, uint64_t def)
+{
+    char val[24];
+    if (!qs || httpd_query_key_value(qs, key, val, sizeof(val)) != ESP_OK)
+        return def;
+    return strtoull(val, NULL, 10);
+}
+
+static esp_err_t history_get_handler(httpd_req_t *req)
+{
+    char qs[96] = "";
+    size_t qs_len = httpd_req_get_url_query_len(req);
+    if (qs_len && qs_len < sizeof(qs))
+        httpd_req_get_url_query_str(req, qs, sizeof(qs));
+
+    history_info_t info;
+    history_info(&info);
+    uint64_t now = esp_timer_get_time() / 1000;
+    uint64_t last = query_u64(qs, "last", 0);
+    uint64_t from = last ? (last < now ? now - last : 0) : query_u64(qs, "from", info.first_ms);
+    uint64_t to = query_u64(qs, "to", now);
+    size_t points = query_u64(qs, "points", HISTORY_POINTS_DEFAULT);
+    if (points < 1 || points > HISTORY_MAX_POINTS)
+        points = HISTORY_MAX_POINTS;
+
+    history_point_t *pts = malloc(points * sizeof(history_point_t));
+    if (!pts)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory");
+        return ESP_OK;
+    }
+    history_point_t total;
+    size_t n = history_query(from, to, pts, points, &total);
+
+    // Sent in chunks of about a dozen points, so the buffer stays small whatever the query
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf),
+                       "{\"now_ms\":%llu,\"capacity\":%lu,\"count\":%lu,\"psram\":%s,"
+                       "\"from_ms\":%llu,\"to_ms\":%llu,"
+                       "\"rollup\":{\"n\":%lu,\"min\":%u,\"max\":%u,\"avg\":%.1f},\"points\":[",
+                       (unsigned long long)now, (unsigned long)info.capacity, (unsigned long)info.count,
+                       info.psram ? "true" : "false", (unsigned long long)from, (unsigned long long)to,
+                       (unsigned long)total.n, total.min, total.max,
+                       total.n ? (double)total.sum / total.n : 0.0);
+
+    httpd_resp_set_type(req, "application/json");
+    for (size_t i = 0; i < n; i++)
+    {
+        if (len > (int)sizeof(buf) - 64)
+        {
+            httpd_resp_send_chunk(req, buf, len);
+            len = 0;
+        }
+        const history_point_t *p = &pts[i];
+        len += snprintf(buf + len, sizeof(buf) - len, "%s[%llu,%lu,%.1f,%u,%u,%u]", i ? "," : "",
+                        (unsigned long long)p->t_ms, (unsigned long)p->n, (double)p->sum / p->n, p->min, p->max,
+                        p->led);
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "]}");
+    httpd_resp_send_chunk(req, buf, len);
+    httpd_resp_send_chunk(req, NULL, 0);
+
+    free(pts);
+    return ESP_OK;
+}
+
+static bool http_stats_send(httpd_req_t *req);
+
+// Everything in /api/status before the per-route counters is 730 bytes with every number at its
+// widest. The counters grow with the route table, so http_stats_send() streams them in chunks.
+#define STATUS_JSON_MAX 1024
+
+static esp_err_t status_get_handler(httpd_req_t *req)
+{
+    char resp[STATUS_JSON_MAX];
+    link_stats_t ls;
+    lcd_render_stats_t rs;
+    lcd_render_stats(&rs);
+    link_telemetry_t lt;
+    uart_link_stats(&ls);
+    bool have = uart_link_telemetry(&lt);
+    int64_t now = esp_timer_get_time();
+    history_info_t hi;
+    history_info(&hi);
+    dashboard_stats_t ds;
+    dashboard_stats(&ds);
+
+    int len = snprintf(resp, sizeof(resp),
+                       "{"
+                       "\"status\":\"ok\","
+                       "\"uptime_ms\":%llu,"
+                       "\"free_heap\":%lu,"
+                       "\"link\":{"
+                       "\"baud\":%lu,\"frames\":%lu,\"crc_errors\":%lu,\"framing_errors\":%lu,"
+                       "\"lost\":%lu,\"overflows\":%lu,\"ready\":%lu,\"busy\":%lu,\"req_edges\":%lu,"
+                       "\"temperature\":%u,\"led\":%u,\"seq\":%lu,\"age_ms\":%lld"
+                       "},"
+                       "\"slave_in\":{\"level\":%d,\"edges\":%lu},"
+                       "\"lcd\":{\"requests\":%lu,\"coalesced\":%lu,\"renders\":%lu,\"cells\":%lu,\"shifts\":%lu,"
+                       "\"glyphs\":%lu,\"last_us\":%lu},"
+                       "\"history\":{\"capacity\":%lu,\"count\":%lu,\"psram\":%s},"
+                       "\"dashboard\":{\"clients\":%lu,\"events\":%lu,\"dropped\":%lu,\"rejected\":%lu,"
+                       "\"not_modified\":%lu}",
+                       (unsigned long long)(now / 1000),
+                       (unsigned long)esp_get_free_heap_size(),
+                       (unsigned long)ls.baud, (unsigned long)ls.frames, (unsigned long)ls.crc_errors,
+                       (unsigned long)ls.framing_errors, (unsigned long)ls.lost, (unsigned long)ls.overflows,
+                       (unsigned long)ls.ready, (unsigned long)ls.busy, (unsigned long)ls.req_edges,
+                       have ? lt.temperature : 0, have ? lt.led : 0, have ? (unsigned long)lt.seq : 0UL,
+                       have ? (long long)((now - lt.rx_us) / 1000) : -1LL,
+                       slave_in_level, (unsigned long)slave_in_edges,
+                       (unsigned long)rs.requests, (unsigned long)rs.coalesced, (unsigned long)rs.renders,
+                       (unsigned long)rs.cells, (unsigned long)rs.shifts, (unsigned long)rs.glyphs,
+                       (unsigned long)rs.last_us,
+                       (unsigned long)hi.capacity, (unsigned long)hi.count, hi.psram ? "true" : "false",
+                       (unsigned long)ds.clients, (unsigned long)ds.events, (unsigned long)ds.dropped,
+                       (unsigned long)ds.rejected, (unsigned long)ds.not_modified);
+    if (len < 0 || len >= (int)sizeof(resp))
+    {
+        // A field outgrew STATUS_JSON_MAX: say so rather than send half an object
+        ESP_LOGE(TAG, "/api/status needs %d bytes, STATUS_JSON_MAX is %d", len, STATUS_JSON_MAX);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Status too long");
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    if (httpd_resp_send_chunk(req, resp, len) != ESP_OK || !http_stats_send(req) ||
+        httpd_resp_send_chunk(req, "}", 1) != ESP_OK)
+        return ESP_FAIL; // the server drops the connection, so the client sees a cut-off response
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
 /* ===================== HTTP SERVER ===================== */
 
-static void start_http_server(void)
+// One server for the life of the program. It listens on any address, so it carries on across Wi-Fi
+// reconnects; the GOT_IP event used to start another instance every time.
+//
+// The POST handlers read the body and parse it, which takes as long as the client takes to send it.
+// They run on worker tasks (httpd_req_async_handler_begin) so one slow client does not hold up the
+// server task and with it every other connection. If every worker is busy the request runs inline,
+// as before, rather than being turned away.
+//
+// Every route goes through http_dispatch, which times it from the moment the server hands it over
+// until the handler has sent the response. /api/status reports the counters per route.
+typedef struct
 {
-    httpd_handle_t server = NULL;
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    bool async; // run on a worker task
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} http_route_t;
+
+typedef struct
+{
+    httpd_req_t *req; // the async copy
+    int64_t t0;
+} http_job_t;
+
+static http_route_t http_routes[] = {
+    {.uri = "/api/text", .method = HTTP_POST, .handler = text_post_handler, .async = true},
+    {.uri = "/api/cmd", .method = HTTP_POST, .handler = cmd_post_handler, .async = true},
+    {.uri = "/api/status", .method = HTTP_GET, .handler = status_get_handler},
+    {.uri = "/api/history", .method = HTTP_GET, .handler = history_get_handler, .async = true},
+    {.uri = "/api/control", .method = HTTP_POST, .handler = control_post_handler, .async = true},
+    {.uri = "/api/live", .method = HTTP_GET, .handler = dashboard_live_handler},
+    {.uri = "/api/events", .method = HTTP_GET, .handler = dashboard_events_handler},
+    {.uri = "/", .method = HTTP_GET, .handler = dashboard_asset_handler},
+    {.uri = "/app.js", .method = HTTP_GET, .handler = dashboard_asset_handler},
+    {.uri = "/styles.css", .method = HTTP_GET, .handler = dashboard_asset_handler},
+};
+
+static httpd_handle_t http_server = NULL;
+static QueueHandle_t http_jobs;
+static portMUX_TYPE http_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t http_async = 0;  // requests run on a worker
+static uint32_t http_inline = 0; // async requests run inline, every worker busy
+
+static void http_record(http_route_t *route, int64_t t0)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+    taskENTER_CRITICAL(&http_mux);
+    route->count++;
+    route->last_us = us;
+    route->total_us += us;
+    if (us > route->max_us)
+        route->max_us = us;
+    taskEXIT_CRITICAL(&http_mux);
+}
+
+static void http_worker(void *arg)
+{
+    (void)arg;
+    http_job_t job;
+
+    for (;;)
+    {
+        xQueueReceive(http_jobs, &job, portMAX_DELAY);
+
+        http_route_t *route = job.req->user_ctx;
+        route->handler(job.req);
+        http_record(route, job.t0);
+        httpd_req_async_handler_complete(job.req);
+    }
+}
+
+static esp_err_t http_dispatch(httpd_req_t *req)
+{
+    http_route_t *route = req->user_ctx;
+    http_job_t job = {.t0 = esp_timer_get_time()};
+
+    if (route->async && uxQueueSpacesAvailable(http_jobs) &&
+        httpd_req_async_handler_begin(req, &job.req) == ESP_OK)
+    {
+        if (xQueueSend(http_jobs, &job, 0) == pdTRUE)
+        {
+            taskENTER_CRITICAL(&http_mux);
+            http_async++;
+            taskEXIT_CRITICAL(&http_mux);
+            return ESP_OK;
+        }
+        httpd_req_async_handler_complete(job.req);
+    }
+    if (route->async)
+    {
+        taskENTER_CRITICAL(&http_mux);
+        http_inline++;
+        taskEXIT_CRITICAL(&http_mux);
+    }
 
-    ESP_ERROR_CHECK(httpd_start(&server, &config));
+    esp_err_t err = route->handler(req);
+    http_record(route, job.t0);
+    return err;
+}
 
-    httpd_uri_t text_uri = {
-        .uri = "/api/text",
-        .method = HTTP_POST,
-        .handler = text_post_handler};
+// Sends the per-route counters, the "http" member of the status response, as chunks. An entry has
+// STATUS_ROUTE_MAX bytes, which any URI shorter than about 40 characters fits; false if one did not,
+// or the client went away.
+#define STATUS_ROUTE_MAX 128
 
-    httpd_uri_t cmd_uri = {
-        .uri = "/api/cmd",
-        .method = HTTP_POST,
-        .handler = cmd_post_handler};
+static bool http_stats_send(httpd_req_t *req)
+{
+    http_route_t routes[sizeof(http_routes) / sizeof(http_routes[0])];
+    uint32_t async, inl;
+
+    taskENTER_CRITICAL(&http_mux);
+    memcpy(routes, http_routes, sizeof(routes));
+    async = http_async;
+    inl = http_inline;
+    taskEXIT_CRITICAL(&http_mux);
+
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf), ",\"http\":{\"async\":%lu,\"inline\":%lu", (unsigned long)async,
+                       (unsigned long)inl);
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
+    {
+        if (len > (int)sizeof(buf) - STATUS_ROUTE_MAX)
+        {
+            if (httpd_resp_send_chunk(req, buf, len) != ESP_OK)
+                return false;
+            len = 0;
+        }
+        const http_route_t *r = &routes[i];
+        int n = snprintf(buf + len, STATUS_ROUTE_MAX,
+                         ",\"%s\":{\"count\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"last_us\":%lu}", r->uri,
+                         (unsigned long)r->count, (unsigned long)(r->count ? r->total_us / r->count : 0),
+                         (unsigned long)r->max_us, (unsigned long)r->last_us);
+        if (n < 0 || n >= STATUS_ROUTE_MAX)
+            return false;
+        len += n;
+    }
+    buf[len++] = '}';
+    return httpd_resp_send_chunk(req, buf, len) == ESP_OK;
+}
 
-    httpd_uri_t status_uri = {
-        .uri = "/api/status",
-        .method = HTTP_GET,
-        .handler = status_get_handler};
+static void start_http_server(void)
+{
+    if (http_server)
+        return; // already listening, a reconnect changes nothing
 
-    httpd_register_uri_handler(server, &text_uri);
-    httpd_register_uri_handler(server, &cmd_uri);
-    httpd_register_uri_handler(server, &status_uri);
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_open_sockets = HTTP_MAX_SOCKETS;
+    config.backlog_conn = HTTP_BACKLOG;
+    config.lru_purge_enable = true; // a new client closes the least recently used idle one
+    config.stack_size = HTTP_STACK;
+    config.task_priority = HTTP_PRIO;
+    config.core_id = HTTP_CORE;
+    config.recv_wait_timeout = HTTP_TIMEOUT_S;
+    config.send_wait_timeout = HTTP_TIMEOUT_S;
+    config.max_uri_handlers = HTTP_MAX_URI_HANDLERS;
+
+    http_jobs = xQueueCreate(HTTP_ASYNC_QUEUE, sizeof(http_job_t));
+    for (int i = 0; i < HTTP_WORKERS; i++)
+        xTaskCreatePinnedToCore(http_worker, "http_worker", HTTP_WORKER_STACK, NULL, HTTP_PRIO, NULL, HTTP_CORE);
+
+    ESP_ERROR_CHECK(httpd_start(&http_server, &config));
+
+    for (size_t i = 0; i < sizeof(http_routes) / sizeof(http_routes[0]); i++)
+    {
+        httpd_uri_t uri = {
+            .uri = http_routes[i].uri,
+            .method = http_routes[i].method,
+            .handler = http_dispatch,
+            .user_ctx = &http_routes[i]};
+        httpd_register_uri_handler(http_server, &uri);
+    }
 
-    ESP_LOGI(TAG, "HTTP server started");
+    ESP_LOGI(TAG, "HTTP server started: %d sockets, %d workers, core %d", HTTP_MAX_SOCKETS, HTTP_WORKERS,
+             HTTP_CORE);
 }
 
 /* ===================== WIFI ===================== */
@@ -261,6 +765,7 @@ static void wifi_event_handler(void *arg,
 
         ESP_LOGI(TAG, "Got IP: %s", ip);
         lcd_show_two_lines("WiFi OK", ip);
+        text_hold(TEXT_HOLD_MS);
         start_http_server();
     }
 }
@@ -300,22 +805,35 @@ void app_main(void)
     gpio_config_t in_conf = {
         .mode = GPIO_MODE_INPUT,
         .pull_down_en = GPIO_PULLDOWN_ENABLE,
-        .pin_bit_mask = (1ULL << SLAVE_IN) | (1ULL << MASTER_IN),
-        .intr_type = GPIO_INTR_NEGEDGE};
+        .pin_bit_mask = (1ULL << SLAVE_IN),
+        .intr_type = GPIO_INTR_ANYEDGE};
     gpio_config(&in_conf);
 
     gpio_config_t out_conf = {
         .mode = GPIO_MODE_OUTPUT,
         .pin_bit_mask =
             (1ULL << SLAVE_OUT) |
-            (1ULL << CLOCK_OUT) |
-            (1ULL << MASTER_LOOP)};
+            (1ULL << CLOCK_OUT)};
     gpio_config(&out_conf);
 
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    slave_in_level = gpio_get_level(SLAVE_IN);
+    xTaskCreate(slave_in_task, "slave_in", 2048, NULL, 5, &slave_in_handle);
+    gpio_isr_handler_add(SLAVE_IN, slave_in_isr, NULL);
+
     ESP_ERROR_CHECK(nvs_flash_init());
 
     lcd_init();
+    lcd_render_start();
+    spark_init();
+    history_init();
+    dashboard_init();
     lcd_show_two_lines("ESP32 Ready", "Waiting...");
 
+    // Text reaches the display through POST /api/text only, which carries the whole message
+    link_handlers_t link_cb = {
+        .on_telemetry = on_link_telemetry};
+    uart_link_start(&link_cb);
+
     wifi_init_sta();
 }
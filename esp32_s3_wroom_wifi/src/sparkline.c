@@ -0,0 +1,77 @@
+#include "sparkline.h"
+#include <string.h>
+
+// The HD44780 has no graphics, only 8 user glyphs. Placed side by side they are a 40 x 8 pixel strip,
+// one pixel column per SPARK_COL_MS of temperature. Loading a glyph is 9 bytes on the bus, and every
+// character that shows it changes with it, so the strip is updated by reloading glyphs, never by
+// rewriting text.
+//
+// A scrolling strip would move every column one pixel on each step and so change all 8 glyphs. This
+// one sweeps instead, like a chart recorder: the new column overwrites the oldest one and the column
+// after it is blanked as a marker. Unless the scale changes, one step touches one glyph, two at a
+// glyph boundary. The render task's CGRAM shadow then loads only those.
+
+void sparkline_init(sparkline_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    for (int i = 0; i < SPARK_COLS; i++)
+        s->col[i] = SPARK_NONE;
+}
+
+// Closes the current period into its column and moves on
+static void sparkline_close(sparkline_t *s)
+{
+    s->col[s->next] = s->n ? (uint16_t)((s->sum + s->n / 2) / s->n) : SPARK_NONE;
+    s->next = (s->next + 1) % SPARK_COLS;
+    s->sum = 0;
+    s->n = 0;
+}
+
+bool sparkline_add(sparkline_t *s, uint16_t value, int64_t now_us)
+{
+    bool closed = false;
+
+    if (s->period_end_us == 0)
+        s->period_end_us = now_us + SPARK_COL_MS * 1000LL;
+
+    // Periods without any sample (link down) become blank columns, at most a full strip of them
+    for (int i = 0; now_us >= s->period_end_us; i++)
+    {
+        if (i < SPARK_COLS)
+            sparkline_close(s);
+        s->period_end_us += SPARK_COL_MS * 1000LL;
+        closed = true;
+    }
+
+    s->sum += value;
+    s->n++;
+    return closed;
+}
+
+void sparkline_glyphs(const sparkline_t *s, uint8_t out[SPARK_GLYPHS][SPARK_GLYPH_ROWS])
+{
+    uint16_t lo = UINT16_MAX, hi = 0;
+    for (int i = 0; i < SPARK_COLS; i++)
+    {
+        if (s->col[i] == SPARK_NONE)
+            continue;
+        if (s->col[i] < lo)
+            lo = s->col[i];
+        if (s->col[i] > hi)
+            hi = s->col[i];
+    }
+
+    memset(out, 0, SPARK_GLYPHS * SPARK_GLYPH_ROWS);
+    for (int c = 0; c < SPARK_COLS; c++)
+    {
+        uint16_t v = s->col[c];
+        if (v == SPARK_NONE || c == s->next)
+            continue; // no data, or the blank column after the newest
+
+        // 1..8 pixels, so the lowest value still shows; a flat line sits in the middle
+        int h = (hi > lo) ? 1 + (v - lo) * (SPARK_GLYPH_ROWS - 1) / (hi - lo) : SPARK_GLYPH_ROWS / 2;
+        uint8_t bit = (uint8_t)(1u << (4 - c % 5));
+        for (int r = SPARK_GLYPH_ROWS - h; r < SPARK_GLYPH_ROWS; r++)
+            out[c / 5][r] |= bit;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef SPARKLINE_H
+#define SPARKLINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The HD44780 has 8 user glyphs of 5x8 pixels. Side by side they make a 40 x 8 pixel strip.
+#define SPARK_GLYPHS 8
+#define SPARK_GLYPH_ROWS 8
+#define SPARK_COLS (SPARK_GLYPHS * 5)
+
+// Each pixel column is the average of this long, so the strip covers 20 minutes
+#define SPARK_COL_MS 30000
+
+// Character codes that show the glyphs. 0x08..0x0F are aliases of CGRAM 0..7, used instead of 0x00..0x07
+// so the strip can be part of a C string.
+#define SPARK_CHAR(g) ((char)(0x08 + (g)))
+
+#define SPARK_NONE 0xFFFF // no sample in that period
+
+/**
+ * @brief Sparkline state: a sweep of SPARK_COLS columns
+ */
+typedef struct
+{
+    uint16_t col[SPARK_COLS]; /*!< column values, SPARK_NONE where there was no data */
+    uint8_t next;             /*!< column the current period goes into */
+    uint32_t sum;             /*!< samples so far in the current period */
+    uint32_t n;
+    int64_t period_end_us;    /*!< when the current period closes, 0 before the first sample */
+} sparkline_t;
+
+/**
+ * @brief Clears the strip
+ */
+void sparkline_init(sparkline_t *s);
+
+/**
+ * @brief Adds a sample
+ *
+ * @param s Sparkline
+ * @param value Temperature
+ * @param now_us esp_timer time
+ *
+ * @return true if a column was completed, and the glyphs should be redrawn
+ */
+bool sparkline_add(sparkline_t *s, uint16_t value, int64_t now_us);
+
+/**
+ * @brief Draws the strip into glyph bitmaps
+ *
+ * @param s Sparkline
+ * @param out One bitmap per glyph, top row first, pixels in bits 4..0 left to right
+ *
+ * Columns are scaled between the lowest and highest value on the strip. Like a chart recorder, the
+ * newest column is written over the oldest and the one after it is left blank to mark the position,
+ * so a new column only changes the one or two glyphs around it.
+ */
+void sparkline_glyphs(const sparkline_t *s, uint8_t out[SPARK_GLYPHS][SPARK_GLYPH_ROWS]);
+
+#endif /* SPARKLINE_H */
@@ -0,0 +1,401 @@
+#include "uart_link.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// The master streams COBS frames, so every 0x00 on the wire ends a frame. The UART driver's pattern
+// detection is set to that byte: its ISR moves the FIFO into the driver's ring buffer and posts
+// UART_PATTERN_DET with the delimiter's position, and the task below reads exactly one frame out of
+// the ring and decodes it in place. No per-byte work on the CPU, and no copy after the one read.
+//
+// Flow control: the ready line tells the master whether to keep sending. The RX task can fall behind
+// while a handler redraws the LCD, so a separate task watches how much is waiting in the driver's ring
+// and drops ready above LINK_RX_HIGH, raising it again below LINK_RX_LOW. It wakes on a task
+// notification: from the GPIO ISR when the master pulls its request line low, and from the RX task
+// after every event, so ready follows the buffer within microseconds of either. While the RX task is
+// stuck, the LINK_HS_POLL_MS timeout catches the buffer filling; the gap to LINK_RX_BUF covers that.
+
+#define LINK_RX_BUF 4096
+#define LINK_TX_BUF 512
+#define LINK_EVENT_QUEUE 32
+#define LINK_PATTERN_QUEUE 64
+#define LINK_TASK_STACK 4096
+#define LINK_TASK_PRIO 10
+#define LINK_HS_STACK 2048
+#define LINK_HS_PRIO 12
+#define LINK_HS_POLL_MS 10
+#define LINK_RX_HIGH (LINK_RX_BUF / 2) // 2 KB: over 20 ms at 921600 baud before the ring is full
+#define LINK_RX_LOW (LINK_RX_BUF / 8)
+#define LINK_STATS_MS 1000
+#define LINK_SILENCE_MS 5000
+#define LINK_PAYLOAD_MAX (2 + LINK_MAX_DATA + 2)
+#define LINK_FRAME_MAX (LINK_PAYLOAD_MAX + LINK_PAYLOAD_MAX / 254 + 2)
+
+static const char *TAG = "LINK";
+
+static QueueHandle_t link_queue;
+static link_handlers_t link_handlers;
+static portMUX_TYPE link_mux = portMUX_INITIALIZER_UNLOCKED;
+static link_telemetry_t link_latest;
+static bool link_have_telemetry = false;
+static link_stats_t link_stats = {.baud = LINK_BAUD_BOOT};
+static bool link_have_seq = false;
+static uint8_t link_last_seq = 0;
+static uint8_t link_tx_seq = 0;
+static int64_t link_last_rx_us = 0;
+static TaskHandle_t link_hs_handle;
+
+/* ===================== CODEC ===================== */
+
+static uint16_t link_crc16(const uint8_t *p, size_t n)
+{
+    uint16_t crc = 0xFFFF;
+    while (n--)
+    {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Decodes COBS in place (the output never overtakes the input). Returns the length, or -1.
+static int link_cobs_decode(uint8_t *buf, size_t n)
+{
+    size_t i = 0, o = 0;
+
+    while (i < n)
+    {
+        uint8_t code = buf[i++];
+        if (code == 0 || i + code - 1 > n)
+            return -1;
+        for (uint8_t k = 1; k < code; k++)
+        {
+            if (!buf[i])
+                return -1;
+            buf[o++] = buf[i++];
+        }
+        if (code != 0xFF && i < n)
+            buf[o++] = 0;
+    }
+    return (int)o;
+}
+
+static size_t link_cobs_encode(const uint8_t *in, size_t n, uint8_t *out)
+{
+    size_t code_at = 0, o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (in[i])
+        {
+            out[o++] = in[i];
+            code++;
+        }
+        if (!in[i] || code == 0xFF)
+        {
+            out[code_at] = code;
+            code = 1;
+            code_at = o++;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* ===================== TX ===================== */
+
+// Only the link task sends, so the static buffers need no lock.
+static void link_send(uint8_t type, const void *data, size_t n)
+{
+    static uint8_t payload[LINK_PAYLOAD_MAX];
+    static uint8_t frame[LINK_FRAME_MAX];
+
+    if (n > LINK_MAX_DATA)
+        return;
+    payload[0] = type;
+    payload[1] = link_tx_seq++;
+    memcpy(payload + 2, data, n);
+    uint16_t crc = link_crc16(payload, n + 2);
+    payload[n + 2] = (uint8_t)crc;
+    payload[n + 3] = (uint8_t)(crc >> 8);
+
+    size_t len = link_cobs_encode(payload, n + 4, frame);
+    frame[len++] = 0;
+    uart_write_bytes(LINK_UART_NUM, frame, len);
+}
+
+static void link_set_baud(uint32_t baud)
+{
+    uart_wait_tx_done(LINK_UART_NUM, pdMS_TO_TICKS(50));
+    uart_set_baudrate(LINK_UART_NUM, baud);
+    link_stats.baud = baud;
+    ESP_LOGI(TAG, "link at %lu baud", (unsigned long)baud);
+}
+
+/* ===================== RX ===================== */
+
+// One frame without its delimiter, decoded in place. Handlers get pointers into buf.
+static void link_frame(uint8_t *buf, size_t len)
+{
+    if (len == 0)
+        return; // back-to-back delimiters
+
+    int n = link_cobs_decode(buf, len);
+    if (n < 4)
+    {
+        link_stats.framing_errors++;
+        return;
+    }
+    if (link_crc16(buf, n - 2) != (uint16_t)(buf[n - 2] | (buf[n - 1] << 8)))
+    {
+        link_stats.crc_errors++;
+        return;
+    }
+
+    uint8_t type = buf[0], seq = buf[1];
+    const uint8_t *data = buf + 2;
+    size_t data_len = n - 4;
+
+    if (link_have_seq)
+        link_stats.lost += (uint8_t)(seq - link_last_seq - 1);
+    link_have_seq = true;
+    link_last_seq = seq;
+    link_stats.frames++;
+    link_last_rx_us = esp_timer_get_time();
+
+    switch (type)
+    {
+    case LINK_MSG_HELLO:
+    {
+        if (data_len < 4)
+            break;
+        uint32_t baud = get_le32(data);
+        if (baud > LINK_BAUD_MAX)
+            baud = LINK_BAUD_MAX;
+        uint8_t ack[4];
+        put_le32(ack, baud);
+        link_send(LINK_MSG_HELLO_ACK, ack, sizeof(ack));
+        link_set_baud(baud);
+        break;
+    }
+    case LINK_MSG_KEEPALIVE:
+        break; // setting link_last_rx_us above is all it is for
+    case LINK_MSG_TELEMETRY:
+    {
+        if (data_len < 20)
+            break;
+        link_telemetry_t t = {
+            .led = data[1],
+            .temperature = (uint16_t)(data[2] | (data[3] << 8)),
+            .raw = get_le32(data + 4),
+            .timestamp = get_le32(data + 8),
+            .seq = get_le32(data + 12),
+            .applied = (uint16_t)(data[16] | (data[17] << 8)),
+            .rx_us = link_last_rx_us,
+        };
+        taskENTER_CRITICAL(&link_mux);
+        link_latest = t;
+        link_have_telemetry = true;
+        taskEXIT_CRITICAL(&link_mux);
+        if (link_handlers.on_telemetry)
+            link_handlers.on_telemetry(&t);
+        break;
+    }
+    case LINK_MSG_TEXT:
+        if (link_handlers.on_text)
+            link_handlers.on_text((const char *)data, data_len);
+        break;
+    default:
+        break;
+    }
+}
+
+// Reads every complete frame the driver has found a delimiter for.
+static void link_read_frames(void)
+{
+    static uint8_t frame[LINK_FRAME_MAX];
+    int pos;
+
+    while ((pos = uart_pattern_pop_pos(LINK_UART_NUM)) >= 0)
+    {
+        size_t len = (size_t)pos + 1; // delimiter included
+        if (len > sizeof(frame))
+        {
+            // Far too long to be a frame: garbage, or the master is at another baud rate. Drop it.
+            while (len)
+            {
+                size_t n = len > sizeof(frame) ? sizeof(frame) : len;
+                uart_read_bytes(LINK_UART_NUM, frame, n, 0);
+                len -= n;
+            }
+            link_stats.framing_errors++;
+            continue;
+        }
+        if (uart_read_bytes(LINK_UART_NUM, frame, len, 0) == (int)len)
+            link_frame(frame, len - 1);
+    }
+}
+
+/* ===================== FLOW CONTROL ===================== */
+
+static void IRAM_ATTR link_req_isr(void *arg)
+{
+    (void)arg;
+    BaseType_t woken = pdFALSE;
+    link_stats.req_edges++;
+    vTaskNotifyGiveFromISR(link_hs_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void link_hs_task(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LINK_HS_POLL_MS));
+
+        size_t waiting = 0;
+        uart_get_buffered_data_len(LINK_UART_NUM, &waiting);
+        if (link_stats.ready && waiting >= LINK_RX_HIGH)
+        {
+            gpio_set_level(LINK_READY_IO, 0);
+            link_stats.ready = 0;
+            link_stats.busy++;
+        }
+        else if (!link_stats.ready && waiting <= LINK_RX_LOW)
+        {
+            gpio_set_level(LINK_READY_IO, 1);
+            link_stats.ready = 1;
+        }
+    }
+}
+
+static void link_flow_start(void)
+{
+    gpio_config_t req = {
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pin_bit_mask = 1ULL << LINK_REQ_IO,
+        .intr_type = GPIO_INTR_NEGEDGE};
+    gpio_config(&req);
+
+    gpio_config_t ready = {
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = 1ULL << LINK_READY_IO};
+    gpio_config(&ready);
+    gpio_set_level(LINK_READY_IO, 1);
+    link_stats.ready = 1;
+
+    xTaskCreate(link_hs_task, "link_flow", LINK_HS_STACK, NULL, LINK_HS_PRIO, &link_hs_handle);
+    gpio_isr_handler_add(LINK_REQ_IO, link_req_isr, NULL);
+}
+
+static void link_task(void *arg)
+{
+    (void)arg;
+    int64_t next_stats = esp_timer_get_time();
+
+    for (;;)
+    {
+        uart_event_t ev;
+        if (xQueueReceive(link_queue, &ev, pdMS_TO_TICKS(LINK_STATS_MS)))
+        {
+            switch (ev.type)
+            {
+            case UART_PATTERN_DET:
+                link_read_frames();
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                link_stats.overflows++;
+                uart_flush_input(LINK_UART_NUM);
+                uart_pattern_queue_reset(LINK_UART_NUM, LINK_PATTERN_QUEUE);
+                xQueueReset(link_queue);
+                break;
+            case UART_FRAME_ERR:
+            case UART_PARITY_ERR:
+                link_stats.framing_errors++;
+                break;
+            default:
+                break; // UART_DATA: bytes wait in the ring until their delimiter arrives
+            }
+            xTaskNotifyGive(link_hs_handle); // the buffer level changed
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now >= next_stats)
+        {
+            uint8_t stats[12];
+            put_le32(stats, link_stats.frames);
+            put_le32(stats + 4, link_stats.crc_errors);
+            put_le32(stats + 8, link_stats.lost);
+            link_send(LINK_MSG_STATS, stats, sizeof(stats));
+            next_stats = now + LINK_STATS_MS * 1000;
+        }
+        if (link_stats.baud != LINK_BAUD_BOOT && now - link_last_rx_us > LINK_SILENCE_MS * 1000LL)
+            link_set_baud(LINK_BAUD_BOOT); // master restarted: it is back at the boot rate
+    }
+}
+
+/* ===================== API ===================== */
+
+void uart_link_start(const link_handlers_t *handlers)
+{
+    if (handlers)
+        link_handlers = *handlers;
+
+    uart_config_t cfg = {
+        .baud_rate = LINK_BAUD_BOOT,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    ESP_ERROR_CHECK(uart_driver_install(LINK_UART_NUM, LINK_RX_BUF, LINK_TX_BUF, LINK_EVENT_QUEUE, &link_queue, 0));
+    ESP_ERROR_CHECK(uart_param_config(LINK_UART_NUM, &cfg));
+    ESP_ERROR_CHECK(uart_set_pin(LINK_UART_NUM, LINK_TX_IO, LINK_RX_IO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    // 0x00 is the COBS frame delimiter and never appears inside a frame
+    ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(LINK_UART_NUM, 0x00, 1, 9, 0, 0));
+    ESP_ERROR_CHECK(uart_pattern_queue_reset(LINK_UART_NUM, LINK_PATTERN_QUEUE));
+
+    link_flow_start();
+    xTaskCreate(link_task, "uart_link", LINK_TASK_STACK, NULL, LINK_TASK_PRIO, NULL);
+    ESP_LOGI(TAG, "UART link on RX %d / TX %d", LINK_RX_IO, LINK_TX_IO);
+}
+
+bool uart_link_telemetry(link_telemetry_t *out)
+{
+    taskENTER_CRITICAL(&link_mux);
+    bool have = link_have_telemetry;
+    if (have)
+        *out = link_latest;
+    taskEXIT_CRITICAL(&link_mux);
+    return have;
+}
+
+void uart_link_stats(link_stats_t *out)
+{
+    *out = link_stats; // counters are written by the link task only; a torn read is off by one at worst
+}
@@ -0,0 +1,97 @@
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "driver/uart.h"
+#include "driver/gpio.h"
+
+// UART used for the wired link to the Pico 2W (its TX GP4 goes to LINK_RX_IO, its RX GP5 to LINK_TX_IO)
+#define LINK_UART_NUM UART_NUM_1
+#define LINK_TX_IO GPIO_NUM_17
+#define LINK_RX_IO GPIO_NUM_18
+
+// Flow control lines (see uart_link.c)
+#define LINK_REQ_IO GPIO_NUM_7   // in, from the master's GP3: low while it has frames queued
+#define LINK_READY_IO GPIO_NUM_9 // out, to the master's GP2: high while we have room for more
+
+// The link starts at LINK_BAUD_BOOT; the master offers a faster rate and we agree up to LINK_BAUD_MAX
+#define LINK_BAUD_BOOT 115200
+#define LINK_BAUD_MAX 921600
+
+// Frame format, identical to spi_master/link_codec_helper.h on the master:
+//   payload   u8 type | u8 seq | data (0..LINK_MAX_DATA bytes) | u16 CRC-16/CCITT-FALSE, little-endian
+//   wire      COBS(payload) 0x00
+#define LINK_MAX_DATA 64
+
+#define LINK_MSG_HELLO 0x01     // u32 baud offered by the master
+#define LINK_MSG_HELLO_ACK 0x02 // u32 baud agreed, both sides switch
+#define LINK_MSG_KEEPALIVE 0x03 // no data, only keeps the link from counting as silent
+#define LINK_MSG_TELEMETRY 0x10 // 20-byte status record
+#define LINK_MSG_TEXT 0x11      // text for the display, not NUL-terminated
+#define LINK_MSG_LOG 0x20       // text for the master's console
+#define LINK_MSG_STATS 0x21     // u32 frames, u32 crc errors, u32 lost, sent every second
+
+/**
+ * @brief Latest telemetry frame from the master
+ */
+typedef struct
+{
+    uint16_t temperature; /*!< degrees F */
+    uint8_t led;          /*!< LED states, G = bit0, Y = bit1, R = bit2, relay = bit3 */
+    uint32_t raw;         /*!< raw SPI word from the slave */
+    uint32_t timestamp;   /*!< master's clock, seconds */
+    uint32_t seq;         /*!< master's snapshot sequence number */
+    uint16_t applied;     /*!< last LED command ID the slave confirmed */
+    int64_t rx_us;        /*!< esp_timer time it arrived */
+} link_telemetry_t;
+
+/**
+ * @brief Link counters
+ */
+typedef struct
+{
+    uint32_t baud;
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t framing_errors; /*!< bad COBS, too long, or UART frame errors */
+    uint32_t lost;           /*!< frames missing according to the master's seq */
+    uint32_t overflows;      /*!< RX FIFO or ring buffer overruns */
+    uint32_t busy;           /*!< times the ready line was dropped */
+    uint32_t req_edges;      /*!< times the master raised a request */
+    uint32_t ready;          /*!< current level of the ready line */
+} link_stats_t;
+
+/**
+ * @brief Callbacks from the RX task
+ *
+ * Both run on the link task. The pointers are only valid during the call.
+ */
+typedef struct
+{
+    void (*on_telemetry)(const link_telemetry_t *t);
+    void (*on_text)(const char *text, size_t len);
+} link_handlers_t;
+
+/**
+ * @brief Installs the UART driver and starts the link RX task and the flow control task
+ *
+ * @param handlers Called for every telemetry and text frame (either may be NULL)
+ * @note gpio_install_isr_service() must have been called
+ */
+void uart_link_start(const link_handlers_t *handlers);
+
+/**
+ * @brief Copies the latest telemetry frame
+ *
+ * @return false if no telemetry has arrived yet
+ */
+bool uart_link_telemetry(link_telemetry_t *out);
+
+/**
+ * @brief Copies the link counters
+ */
+void uart_link_stats(link_stats_t *out);
+
+#endif /* UART_LINK_H */
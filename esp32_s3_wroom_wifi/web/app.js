@@ -0,0 +1,124 @@
+document.addEventListener("DOMContentLoaded", () => {
+
+    const CHART_HEIGHT = 200;
+    const MAX_TEMP = 100;
+    const PX_PER_DEG = CHART_HEIGHT / MAX_TEMP;
+    const $ = id => document.getElementById(id);
+
+    /* Served by the ESP32 itself. Live values come from /api/events (SSE): the ESP32 pushes the
+       telemetry it gets from the Pico 2W over the UART link, so no viewer adds load on the Pico. */
+
+    $("sendBtn").addEventListener("click", send);
+
+    function send() {
+        fetch("/api/text", {
+            method: "POST",
+            headers: { "Content-Type": "application/json" },
+            body: JSON.stringify({ text: $("msg").value })
+        });
+    }
+
+    /* LED glow */
+    function updateLedGlow(val) {
+        document.querySelectorAll(".cmd-btn").forEach(btn => {
+            const ledId = parseInt(btn.dataset.cmd, 10); // 1–4
+            const bitmask = 1 << (ledId - 1);
+
+            btn.classList.toggle("glow", (val & bitmask) !== 0);
+        });
+    }
+
+    /* Live */
+    const LIVE_POINTS = 60;
+    let liveSamples = [];
+
+    function onLive(d) {
+        $("current").textContent = Number(d.temperature).toFixed(1) + " °F";
+        $("last-updated").textContent = "Last update: " + new Date().toLocaleTimeString();
+        updateLedGlow(d.led);
+
+        // age_ms is how old the Pico's last frame was when the ESP32 sent this
+        const stale = d.age_ms < 0 || d.age_ms > 10000;
+        $("link-state").textContent = stale ? "No data from the Pico 2W" : "Live from the Pico 2W";
+        $("link-state").classList.toggle("stale", stale);
+
+        liveSamples.push(d.temperature);
+        if (liveSamples.length > LIVE_POINTS) liveSamples = liveSamples.slice(-LIVE_POINTS);
+        drawLive();
+    }
+
+    function drawLive() {
+        const strip = $("live-chart");
+        strip.querySelectorAll(".bar").forEach(b => b.remove());
+        liveSamples.forEach(temp => {
+            const bar = document.createElement("div");
+            bar.className = "bar live";
+            bar.style.height = Math.min(60, temp * 60 / MAX_TEMP) + "px";
+            bar.title = `${temp} °F`;
+            strip.appendChild(bar);
+        });
+    }
+
+    // EventSource reconnects by itself if the ESP32 drops the stream
+    const events = new EventSource("/api/events");
+    events.onmessage = e => onLive(JSON.parse(e.data));
+    events.onerror = () => {
+        $("link-state").textContent = "Reconnecting…";
+        $("link-state").classList.add("stale");
+    };
+
+    /* History: the last hour from the ESP32's ring, 30 bars */
+    async function loadHistory() {
+        const chart = $("chart");
+        const tooltip = $("tooltip");
+
+        const r = await fetch("/api/history?last=3600000&points=30");
+        const h = await r.json();
+        const t0 = Date.now() - h.now_ms; // ESP32 boot, on our clock
+
+        chart.querySelectorAll(".bar").forEach(b => b.remove());
+        h.points.forEach(([t, n, avg, min, max]) => {
+            const bar = document.createElement("div");
+            bar.className = "bar";
+
+            const hgt = Math.min(CHART_HEIGHT, avg * PX_PER_DEG);
+            bar.style.height = hgt + "px";
+
+            bar.addEventListener("mouseenter", () => {
+                const at = new Date(t0 + t).toLocaleTimeString();
+                tooltip.textContent = `${avg.toFixed(1)} °F (${min}–${max}) @ ${at}`;
+                tooltip.style.left = bar.offsetLeft + bar.offsetWidth / 2 + "px";
+                tooltip.style.bottom = hgt + "px";
+                tooltip.style.opacity = 1;
+            });
+
+            bar.addEventListener("mouseleave", () => tooltip.style.opacity = 0);
+            chart.appendChild(bar);
+        });
+    }
+
+    /* Commands: the ESP32 forwards these to the Pico 2W */
+    document.querySelectorAll(".cmd-btn").forEach(btn => {
+        btn.addEventListener("click", async () => {
+            // Ask for the opposite of what is lit now, as an absolute state
+            const body = { changes: [{ led: parseInt(btn.dataset.cmd, 10), on: !btn.classList.contains("glow") }] };
+            try {
+                const r = await fetch("/api/control", {
+                    method: "POST",
+                    headers: { "Content-Type": "application/json" },
+                    body: JSON.stringify(body)
+                });
+                $("cmd-status").textContent = r.ok ? ""
+                    : r.status === 503 ? "Pico 2W is busy, try again"
+                    : "Pico 2W did not answer";
+            } catch {
+                $("cmd-status").textContent = "ESP32 did not answer";
+            }
+        });
+    });
+
+    /* Timers */
+    loadHistory();
+    setInterval(loadHistory, 60000);
+
+});
@@ -0,0 +1,9 @@
+# Compresses one dashboard asset for embedding in the firmware (see src/CMakeLists.txt).
+# mtime=0 keeps the output, and so the ETag, the same from build to build.
+import gzip
+import sys
+
+with open(sys.argv[1], "rb") as f:
+    data = f.read()
+with open(sys.argv[2], "wb") as f:
+    f.write(gzip.compress(data, compresslevel=9, mtime=0))
@@ -5,9 +5,27 @@
 if (isset($_GET["action"])) {
 
     if ($_GET["action"] === "led") {
-        $resp = @file_get_contents("$PICO_URL/api/status");
-        $obj  = json_decode($resp, true);
-        echo json_encode(["led" => $obj["led"] ?? 0]);
+        // Packed 20-byte status record (see spi_master/telemetry_helper.h)
+        $resp = @file_get_contents("$PICO_URL/api/status?fmt=bin");
+        $obj  = ($resp !== false && strlen($resp) === 20)
+            ? unpack("Ckind/Cled/vtemperature/Vraw/Vtimestamp/Vseq/vapplied", $resp)
+            : [];
+        echo json_encode(["led" => $obj["led"] ?? 0, "applied" => $obj["applied"] ?? 0]);
+        exit;
+    }
+
+    if ($_GET["action"] === "samples") {
+        // Cursor-based delta from the Pico's in-RAM history ring, passed through in the packed
+        // binary form; app.js decodes it
+        $since = intval($_GET["since"] ?? 0);
+        $max   = intval($_GET["max"] ?? 64);
+        $resp  = @file_get_contents("$PICO_URL/api/history?since=$since&max=$max&fmt=bin");
+        if ($resp === false) {
+            http_response_code(504);
+            exit(json_encode(["error" => "Pico unreachable"]));
+        }
+        header("Content-Type: application/octet-stream");
+        echo $resp;
         exit;
     }
 
@@ -61,18 +79,25 @@ if (isset($_GET["action"])) {
     if ($_GET["action"] === "send" && isset($_POST["cmd"])) {
         $cmd = intval($_POST["cmd"]) & 0xFF;
 
+        // With "on", ask for an absolute state (repeat clicks are harmless); without it, toggle
+        $body = isset($_POST["on"])
+            ? ["changes" => [["led" => $cmd, "on" => $_POST["on"] === "1"]]]
+            : ["led" => $cmd];
+
         $ch = curl_init("$PICO_URL/api/control");
         curl_setopt_array($ch, [
             CURLOPT_POST => true,
             CURLOPT_HTTPHEADER => ["Content-Type: application/json"],
-            CURLOPT_POSTFIELDS => json_encode(["led" => $cmd]),
+            CURLOPT_POSTFIELDS => json_encode($body),
             CURLOPT_RETURNTRANSFER => true,
             CURLOPT_TIMEOUT => 5
         ]);
-        curl_exec($ch);
+        $resp = curl_exec($ch);
         curl_close($ch);
 
-        echo json_encode(["ok" => true, "cmd" => $cmd]);
+        // The Pico answers {"id":..}; /api/status reports "applied" once the slave has confirmed it
+        $ack = $resp ? json_decode($resp, true) : null;
+        echo json_encode(["ok" => $ack !== null, "cmd" => $cmd, "id" => $ack["id"] ?? 0]);
         exit;
     }
 
@@ -27,12 +27,78 @@ document.addEventListener("DOMContentLoaded", () => {
         });
     }
 
-    async function pollLed() {
+    /* Live samples: backfill once from the Pico's RAM history, then only fetch what is new */
+    const LIVE_POINTS = 60;
+    let liveCursor = null;
+    let liveSamples = [];
+    let liveBusy = false;
+
+    /* Packed history from the Pico (spi_master/telemetry_helper.h): 16-byte header, 12 bytes per sample */
+    function decodeHistory(buf) {
+        const v = new DataView(buf);
+        const flags = v.getUint8(1);
+        const count = v.getUint16(2, true);
+        const first = v.getUint32(4, true);
+        const samples = [];
+        for (let i = 0, o = 16; i < count; i++, o += 12) {
+            samples.push([first + i, v.getUint32(o, true), v.getUint32(o + 4, true),
+                          v.getUint16(o + 8, true), v.getUint8(o + 10)]);
+        }
+        return {
+            samples,
+            head: v.getUint32(8, true),
+            next: first + count - 1,
+            now: v.getUint32(12, true),
+            more: !!(flags & 1),
+            gap: !!(flags & 2)
+        };
+    }
+
+    async function fetchSamples(since, max) {
+        const r = await fetch(`?action=samples&since=${since}&max=${max}`);
+        return decodeHistory(await r.arrayBuffer());
+    }
+
+    async function pollSamples() {
+        if (liveBusy) return; // previous poll still waiting on the Pico
+        liveBusy = true;
         try {
-            const r = await fetch("?action=led");
-            const j = await r.json();
-            updateLedGlow(j.led);
+            if (liveCursor === null) {
+                // First call: ask only for the head, then backfill the last LIVE_POINTS
+                const h = await fetchSamples(0, 0);
+                liveCursor = Math.max(0, h.head - LIVE_POINTS);
+            }
+
+            let j;
+            do {
+                j = await fetchSamples(liveCursor, LIVE_POINTS);
+                if (j.next < liveCursor) liveSamples = []; // Pico restarted
+                j.samples.forEach(s => liveSamples.push({ seq: s[0], t: s[1], temp: s[3], led: s[4] }));
+                liveCursor = j.next;
+            } while (j.more);
+
+            if (liveSamples.length > LIVE_POINTS) liveSamples = liveSamples.slice(-LIVE_POINTS);
+
+            const last = liveSamples[liveSamples.length - 1];
+            if (last) {
+                $("current").textContent = Number(last.temp).toFixed(1) + " °F";
+                updateLedGlow(last.led);
+            }
+            drawLive();
         } catch { }
+        liveBusy = false;
+    }
+
+    function drawLive() {
+        const strip = $("live-chart");
+        strip.querySelectorAll(".bar").forEach(b => b.remove());
+        liveSamples.forEach(s => {
+            const bar = document.createElement("div");
+            bar.className = "bar live";
+            bar.style.height = Math.min(60, s.temp * 60 / MAX_TEMP) + "px";
+            bar.title = `${s.temp} °F`;
+            strip.appendChild(bar);
+        });
     }
 
     /* Status */
@@ -80,7 +146,9 @@ document.addEventListener("DOMContentLoaded", () => {
             fetch("?action=send", {
                 method: "POST",
                 headers: { "Content-Type": "application/x-www-form-urlencoded" },
-                body: "cmd=" + encodeURIComponent(btn.dataset.cmd)
+                // Ask for the opposite of what is lit now, as an absolute state
+                body: "cmd=" + encodeURIComponent(btn.dataset.cmd) +
+                      "&on=" + (btn.classList.contains("glow") ? "0" : "1")
             });
         });
     });
@@ -88,6 +156,7 @@ document.addEventListener("DOMContentLoaded", () => {
     /* Timers */
     fetchStatus();
     setInterval(fetchStatus, 300000);
-    setInterval(pollLed, 500);
+    pollSamples();
+    setInterval(pollSamples, 500);
 
 });
@@ -315,7 +315,8 @@ static cJSON_bool parse_number(cJSON *const item, parse_buffer *const input_buff
 {
     double number = 0;
     unsigned char *after_end = NULL;
-    unsigned char *number_c_string;
+    unsigned char number_buffer[64]; /* enough for any double cJSON prints, so usually no allocation */
+    unsigned char *number_c_string = number_buffer;
     unsigned char decimal_point = get_decimal_point();
     size_t i = 0;
     size_t number_string_length = 0;
@@ -360,11 +361,14 @@ static cJSON_bool parse_number(cJSON *const item, parse_buffer *const input_buff
         }
     }
 loop_end:
-    /* malloc for temporary buffer, add 1 for '\0' */
-    number_c_string = (unsigned char *)input_buffer->hooks.allocate(number_string_length + 1);
-    if (number_c_string == NULL)
+    /* malloc for temporary buffer if it is unusually long, add 1 for '\0' */
+    if (number_string_length >= sizeof(number_buffer))
     {
-        return false; /* allocation failure */
+        number_c_string = (unsigned char *)input_buffer->hooks.allocate(number_string_length + 1);
+        if (number_c_string == NULL)
+        {
+            return false; /* allocation failure */
+        }
     }
 
     memcpy(number_c_string, buffer_at_offset(input_buffer), number_string_length);
@@ -386,7 +390,10 @@ loop_end:
     if (number_c_string == after_end)
     {
         /* free the temporary buffer */
-        input_buffer->hooks.deallocate(number_c_string);
+        if (number_c_string != number_buffer)
+        {
+            input_buffer->hooks.deallocate(number_c_string);
+        }
         return false; /* parse_error */
     }
 
@@ -410,7 +417,10 @@ loop_end:
 
     input_buffer->offset += (size_t)(after_end - number_c_string);
     /* free the temporary buffer */
-    input_buffer->hooks.deallocate(number_c_string);
+    if (number_c_string != number_buffer)
+    {
+        input_buffer->hooks.deallocate(number_c_string);
+    }
     return true;
 }
 
@@ -824,8 +834,9 @@ fail:
     return 0;
 }
 
-/* Parse the input text into an unescaped cinput, and populate item. */
-static cJSON_bool parse_string(cJSON *const item, parse_buffer *const input_buffer)
+/* Parse the string literal at the offset into an unescaped C string. The output goes to preallocated when
+ * given (it must hold at least the literal's length), otherwise to a new allocation returned in *output_string. */
+static cJSON_bool parse_string_into(parse_buffer *const input_buffer, unsigned char *const preallocated, size_t preallocated_length, unsigned char **const output_string)
 {
     const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
     const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
@@ -864,7 +875,18 @@ static cJSON_bool parse_string(cJSON *const item, parse_buffer *const input_buff
 
         /* This is at most how much we need for the output */
         allocation_length = (size_t)(input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char *)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        if (preallocated != NULL)
+        {
+            if (allocation_length + sizeof("") > preallocated_length)
+            {
+                goto fail;
+            }
+            output = preallocated;
+        }
+        else
+        {
+            output = (unsigned char *)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        }
         if (output == NULL)
         {
             goto fail; /* allocation failure */
@@ -931,8 +953,7 @@ static cJSON_bool parse_string(cJSON *const item, parse_buffer *const input_buff
     /* zero terminate the output */
     *output_pointer = '\0';
 
-    item->type = cJSON_String;
-    item->valuestring = (char *)output;
+    *output_string = output;
 
     input_buffer->offset = (size_t)(input_end - input_buffer->content);
     input_buffer->offset++;
@@ -940,7 +961,7 @@ static cJSON_bool parse_string(cJSON *const item, parse_buffer *const input_buff
     return true;
 
 fail:
-    if (output != NULL)
+    if ((output != NULL) && (output != preallocated))
     {
         input_buffer->hooks.deallocate(output);
         output = NULL;
@@ -954,6 +975,22 @@ fail:
     return false;
 }
 
+/* Parse the input text into an unescaped cinput, and populate item. */
+static cJSON_bool parse_string(cJSON *const item, parse_buffer *const input_buffer)
+{
+    unsigned char *output = NULL;
+
+    if (!parse_string_into(input_buffer, NULL, 0, &output))
+    {
+        return false;
+    }
+
+    item->type = cJSON_String;
+    item->valuestring = (char *)output;
+
+    return true;
+}
+
 /* Render the cstring provided to an escaped version that can be printed. */
 static cJSON_bool print_string_ptr(const unsigned char *const input, printbuffer *const output_buffer)
 {
@@ -1784,6 +1821,381 @@ fail:
     return false;
 }
 
+/* Streaming parser. The input is consumed a byte at a time by a small state machine, so it can arrive in
+ * chunks of any size. Only the current string, number or literal is buffered (it may span chunks); once
+ * complete it is decoded by parse_string_into/parse_number and reported. Open containers are one bit per
+ * level in sax->containers. Nothing is allocated. */
+enum
+{
+    sax_state_value,        /* a value must come next */
+    sax_state_value_or_end, /* just after '[' */
+    sax_state_key,          /* after ',' in an object */
+    sax_state_key_or_end,   /* just after '{' */
+    sax_state_colon,
+    sax_state_after_value, /* ',' or the end of the container */
+    sax_state_key_string,
+    sax_state_string,
+    sax_state_number,
+    sax_state_literal,
+    sax_state_done
+};
+
+#define sax_max_depth cjson_min(sizeof(unsigned long) * CHAR_BIT, CJSON_NESTING_LIMIT)
+
+static cJSON_bool sax_in_object(const cJSON_SAX *const sax)
+{
+    return (sax->depth > 0) && (((sax->containers >> (sax->depth - 1)) & 1) != 0);
+}
+
+/* report a value or the start of a container, with its member name if it has one */
+static cJSON_SAX_Status sax_emit(cJSON_SAX *const sax, cJSON_SAX_Event event, cJSON *const item)
+{
+    item->string = sax->have_key ? sax->key : NULL;
+    sax->have_key = false;
+
+    if (!sax->callback(event, item, sax->depth, sax->user))
+    {
+        return cJSON_SAX_Stopped;
+    }
+    return cJSON_SAX_More;
+}
+
+/* a value is complete: the document is done if it was the root */
+static cJSON_SAX_Status sax_value_done(cJSON_SAX *const sax)
+{
+    if (sax->depth == 0)
+    {
+        sax->state = sax_state_done;
+        return cJSON_SAX_Done;
+    }
+    sax->state = sax_state_after_value;
+    return cJSON_SAX_More;
+}
+
+static cJSON_SAX_Status sax_open(cJSON_SAX *const sax, cJSON_bool object)
+{
+    cJSON item;
+    cJSON_SAX_Status status;
+
+    if (sax->depth >= sax_max_depth)
+    {
+        return cJSON_SAX_Error; /* chained too deeply */
+    }
+
+    memset(&item, '\0', sizeof(item));
+    item.type = object ? cJSON_Object : cJSON_Array;
+    status = sax_emit(sax, object ? cJSON_SAX_StartObject : cJSON_SAX_StartArray, &item);
+
+    if (object)
+    {
+        sax->containers |= 1UL << sax->depth;
+    }
+    else
+    {
+        sax->containers &= ~(1UL << sax->depth);
+    }
+    sax->depth++;
+    sax->state = object ? sax_state_key_or_end : sax_state_value_or_end;
+
+    return status;
+}
+
+static cJSON_SAX_Status sax_close(cJSON_SAX *const sax, cJSON_bool object)
+{
+    cJSON item;
+
+    if ((sax->depth == 0) || (sax_in_object(sax) != object))
+    {
+        return cJSON_SAX_Error; /* '}' closing an array or the other way round */
+    }
+    sax->depth--;
+
+    memset(&item, '\0', sizeof(item));
+    item.type = object ? cJSON_Object : cJSON_Array;
+    if (!sax->callback(object ? cJSON_SAX_EndObject : cJSON_SAX_EndArray, &item, sax->depth, sax->user))
+    {
+        return cJSON_SAX_Stopped;
+    }
+
+    return sax_value_done(sax);
+}
+
+/* decode the buffered token and report it */
+static cJSON_SAX_Status sax_token(cJSON_SAX *const sax)
+{
+    parse_buffer buffer = {0, 0, 0, 0, {0, 0, 0}};
+    unsigned char *output = NULL;
+    cJSON_SAX_Status status;
+    cJSON item;
+
+    memset(&item, '\0', sizeof(item));
+    buffer.content = sax->token;
+    buffer.length = sax->token_length;
+    buffer.depth = sax->depth;
+    buffer.hooks = global_hooks;
+
+    switch (sax->state)
+    {
+    case sax_state_key_string:
+        /* the unescaped string is never longer than the literal, so it can overwrite it */
+        if (!parse_string_into(&buffer, sax->token, sizeof(sax->token), &output) || (strlen((const char *)output) > CJSON_SAX_KEY_MAX))
+        {
+            return cJSON_SAX_Error;
+        }
+        strcpy(sax->key, (const char *)output);
+        item.type = cJSON_String;
+        item.valuestring = sax->key;
+        item.string = sax->key;
+        sax->have_key = true;
+        sax->state = sax_state_colon;
+        if (!sax->callback(cJSON_SAX_Key, &item, sax->depth, sax->user))
+        {
+            return cJSON_SAX_Stopped;
+        }
+        return cJSON_SAX_More;
+
+    case sax_state_string:
+        if (!parse_string_into(&buffer, sax->token, sizeof(sax->token), &output))
+        {
+            return cJSON_SAX_Error;
+        }
+        item.type = cJSON_String;
+        item.valuestring = (char *)output;
+        break;
+
+    case sax_state_number:
+        /* the whole token must be the number, "1-2" is not one */
+        if (!parse_number(&item, &buffer) || (buffer.offset != buffer.length))
+        {
+            return cJSON_SAX_Error;
+        }
+        break;
+
+    default: /* sax_state_literal */
+        if ((sax->token_length == 4) && (strncmp((const char *)sax->token, "null", 4) == 0))
+        {
+            item.type = cJSON_NULL;
+        }
+        else if ((sax->token_length == 4) && (strncmp((const char *)sax->token, "true", 4) == 0))
+        {
+            item.type = cJSON_True;
+            item.valueint = 1;
+        }
+        else if ((sax->token_length == 5) && (strncmp((const char *)sax->token, "false", 5) == 0))
+        {
+            item.type = cJSON_False;
+        }
+        else
+        {
+            return cJSON_SAX_Error;
+        }
+        break;
+    }
+
+    status = sax_emit(sax, cJSON_SAX_Value, &item);
+    if (status != cJSON_SAX_More)
+    {
+        return status;
+    }
+    return sax_value_done(sax);
+}
+
+static cJSON_SAX_Status sax_token_start(cJSON_SAX *const sax, int state, unsigned char c)
+{
+    sax->state = state;
+    sax->escape = false;
+    sax->token[0] = c;
+    sax->token_length = 1;
+    return cJSON_SAX_More;
+}
+
+static cJSON_bool sax_number_char(unsigned char c)
+{
+    return ((c >= '0') && (c <= '9')) || (c == '+') || (c == '-') || (c == 'e') || (c == 'E') || (c == '.');
+}
+
+static cJSON_SAX_Status sax_step(cJSON_SAX *const sax, unsigned char c)
+{
+    cJSON_SAX_Status status;
+
+    switch (sax->state)
+    {
+    case sax_state_key_string:
+    case sax_state_string:
+        if (sax->token_length >= CJSON_SAX_TOKEN_MAX)
+        {
+            return cJSON_SAX_Error; /* longer than the token buffer */
+        }
+        sax->token[sax->token_length++] = c;
+        if (sax->escape)
+        {
+            sax->escape = false;
+        }
+        else if (c == '\\')
+        {
+            sax->escape = true;
+        }
+        else if (c == '\"')
+        {
+            return sax_token(sax);
+        }
+        return cJSON_SAX_More;
+
+    case sax_state_number:
+    case sax_state_literal:
+        if ((sax->state == sax_state_number) ? sax_number_char(c) : ((c >= 'a') && (c <= 'z')))
+        {
+            if (sax->token_length >= CJSON_SAX_TOKEN_MAX)
+            {
+                return cJSON_SAX_Error;
+            }
+            sax->token[sax->token_length++] = c;
+            return cJSON_SAX_More;
+        }
+        /* c ends the token, and then belongs to whatever follows it */
+        status = sax_token(sax);
+        if (status != cJSON_SAX_More)
+        {
+            return status;
+        }
+        return sax_step(sax, c);
+
+    case sax_state_done:
+        return cJSON_SAX_Done;
+
+    default:
+        break;
+    }
+
+    /* between tokens */
+    if (c <= 32)
+    {
+        return cJSON_SAX_More;
+    }
+
+    switch (sax->state)
+    {
+    case sax_state_colon:
+        if (c != ':')
+        {
+            return cJSON_SAX_Error;
+        }
+        sax->state = sax_state_value;
+        return cJSON_SAX_More;
+
+    case sax_state_after_value:
+        if (c == ',')
+        {
+            sax->state = sax_in_object(sax) ? sax_state_key : sax_state_value;
+            return cJSON_SAX_More;
+        }
+        if ((c == '}') || (c == ']'))
+        {
+            return sax_close(sax, c == '}');
+        }
+        return cJSON_SAX_Error;
+
+    case sax_state_key_or_end:
+        if (c == '}')
+        {
+            return sax_close(sax, true);
+        }
+        /* fall through */
+    case sax_state_key:
+        if (c != '\"')
+        {
+            return cJSON_SAX_Error;
+        }
+        return sax_token_start(sax, sax_state_key_string, c);
+
+    case sax_state_value_or_end:
+        if (c == ']')
+        {
+            return sax_close(sax, false);
+        }
+        /* fall through */
+    default: /* sax_state_value */
+        if ((c == '{') || (c == '['))
+        {
+            return sax_open(sax, c == '{');
+        }
+        if (c == '\"')
+        {
+            return sax_token_start(sax, sax_state_string, c);
+        }
+        if ((c == '-') || ((c >= '0') && (c <= '9')))
+        {
+            return sax_token_start(sax, sax_state_number, c);
+        }
+        if ((c == 't') || (c == 'f') || (c == 'n'))
+        {
+            return sax_token_start(sax, sax_state_literal, c);
+        }
+        return cJSON_SAX_Error;
+    }
+}
+
+CJSON_PUBLIC(void)
+cJSON_SAX_Init(cJSON_SAX *sax, cJSON_SAX_Callback callback, void *user)
+{
+    if (sax == NULL)
+    {
+        return;
+    }
+
+    memset(sax, '\0', sizeof(*sax));
+    sax->callback = callback;
+    sax->user = user;
+    sax->state = sax_state_value;
+    sax->status = (callback != NULL) ? cJSON_SAX_More : cJSON_SAX_Error;
+}
+
+CJSON_PUBLIC(cJSON_SAX_Status)
+cJSON_SAX_Feed(cJSON_SAX *sax, const char *chunk, size_t length)
+{
+    size_t i = 0;
+
+    if ((sax == NULL) || ((chunk == NULL) && (length > 0)))
+    {
+        return cJSON_SAX_Error;
+    }
+
+    for (i = 0; (i < length) && (sax->status == cJSON_SAX_More); i++)
+    {
+        sax->status = sax_step(sax, (unsigned char)chunk[i]);
+        if (sax->status != cJSON_SAX_Error)
+        {
+            sax->position++;
+        }
+    }
+
+    return sax->status;
+}
+
+CJSON_PUBLIC(cJSON_SAX_Status)
+cJSON_SAX_Finish(cJSON_SAX *sax)
+{
+    if (sax == NULL)
+    {
+        return cJSON_SAX_Error;
+    }
+
+    if (sax->status == cJSON_SAX_More)
+    {
+        /* only a bare number or literal at the root can end with the input, anything else is cut short */
+        if ((sax->depth == 0) && ((sax->state == sax_state_number) || (sax->state == sax_state_literal)))
+        {
+            sax->status = sax_token(sax);
+        }
+        else
+        {
+            sax->status = cJSON_SAX_Error;
+        }
+    }
+
+    return sax->status;
+}
+
 /* Render an object to text. */
 static cJSON_bool print_object(const cJSON *const item, printbuffer *const output_buffer)
 {
@@ -141,6 +141,15 @@ extern "C"
  * This is to prevent stack overflows. */
 #ifndef CJSON_CIRCULAR_LIMIT
 #define CJSON_CIRCULAR_LIMIT 10000
+#endif
+
+/* Longest string or number token, and longest object key, the streaming parser can hold.
+ * Both are buffered inside cJSON_SAX, so keep them small on small targets. */
+#ifndef CJSON_SAX_TOKEN_MAX
+#define CJSON_SAX_TOKEN_MAX 128
+#endif
+#ifndef CJSON_SAX_KEY_MAX
+#define CJSON_SAX_KEY_MAX 32
 #endif
 
     /* returns the version of cJSON as a string */
@@ -368,6 +377,55 @@ extern "C"
 /* Macro for iterating over an array or object */
 #define cJSON_ArrayForEach(element, array) for (element = (array != NULL) ? (array)->child : NULL; element != NULL; element = element->next)
 
+    /* Streaming (SAX-style) parsing: events instead of a tree, no allocation, input in any number of chunks. */
+    typedef enum
+    {
+        cJSON_SAX_StartObject,
+        cJSON_SAX_EndObject,
+        cJSON_SAX_StartArray,
+        cJSON_SAX_EndArray,
+        cJSON_SAX_Key,  /* item->string is the member name */
+        cJSON_SAX_Value /* item holds a string, number, true, false or null; item->string is its member name, NULL in an array */
+    } cJSON_SAX_Event;
+
+    typedef enum
+    {
+        cJSON_SAX_More,    /* valid so far, feed more */
+        cJSON_SAX_Done,    /* the value is complete; anything after it is ignored, as cJSON_Parse does */
+        cJSON_SAX_Stopped, /* the callback returned false */
+        cJSON_SAX_Error
+    } cJSON_SAX_Status;
+
+    /* item is only valid during the call. depth counts the arrays/objects around the item (0 for the root).
+     * Return false to stop parsing, for example once the wanted keys have been seen. */
+    typedef cJSON_bool (*cJSON_SAX_Callback)(cJSON_SAX_Event event, const cJSON *item, size_t depth, void *user);
+
+    typedef struct cJSON_SAX
+    {
+        cJSON_SAX_Callback callback;
+        void *user;
+        int state;
+        cJSON_SAX_Status status;
+        size_t depth;
+        unsigned long containers; /* bit n set: container n is an object */
+        cJSON_bool escape;
+        cJSON_bool have_key;
+        size_t token_length;
+        size_t position; /* bytes consumed, where the error is once status is cJSON_SAX_Error */
+        unsigned char token[CJSON_SAX_TOKEN_MAX + 1];
+        char key[CJSON_SAX_KEY_MAX + 1];
+    } cJSON_SAX;
+
+    /* Prepare sax for a new document. */
+    CJSON_PUBLIC(void)
+    cJSON_SAX_Init(cJSON_SAX *sax, cJSON_SAX_Callback callback, void *user);
+    /* Parse the next length bytes. Events for complete tokens are delivered before it returns. */
+    CJSON_PUBLIC(cJSON_SAX_Status)
+    cJSON_SAX_Feed(cJSON_SAX *sax, const char *chunk, size_t length);
+    /* End of input: completes a bare number or literal at the root. cJSON_SAX_Done only if the value was complete. */
+    CJSON_PUBLIC(cJSON_SAX_Status)
+    cJSON_SAX_Finish(cJSON_SAX *sax);
+
     /* malloc/free objects using the malloc/free functions that have been set with cJSON_InitHooks */
     CJSON_PUBLIC(void *)
     cJSON_malloc(size_t size);
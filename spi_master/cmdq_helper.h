@@ -0,0 +1,183 @@
+#ifndef CMDQ_HELPER_H
+#define CMDQ_HELPER_H
+
+// This is cmdq_helper.h, the command queue from the HTTP handlers (Core1) to the SPI engine (Core0).
+// It replaces the single pending_cmd byte, where a second request that arrived before Core0 woke up
+// simply overwrote the first. Every command is now its own typed entry, in order, and a script that
+// fires off twenty commands gets twenty commands delivered (or a 503 for the ones that did not fit).
+//
+// It is a bounded ring in plain SRAM, with a sequence number per cell (the well-known Vyukov design).
+// Producers claim a cell with one compare-and-swap on cmdq_tail, fill it, then publish it by bumping
+// the cell's sequence. Core0, the only consumer, reads cells in order and hands each one back with
+// another sequence bump. No locks, no interrupts disabled, and a full queue is a refusal, not a wait.
+// RP2350 has a global exclusive monitor on SRAM, so the CAS works across the two cores.
+//
+// Core0 drains up to CMDQ_BATCH commands at the top of each loop. All LED changes in one batch are
+// merged and go out in a single SPI exchange (see control_helper.h).
+
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define CMDQ_LEN 16 // power of two
+#define CMDQ_BATCH 8
+
+typedef enum
+{
+    CMD_LED_SET = 1, // set the LEDs in mask to value
+    CMD_CONFIG,      // change a Core0 setting
+    CMD_READ,        // exchange with the slave now instead of waiting out the poll interval
+} cmd_type_t;
+
+typedef enum
+{
+    CFG_POLL_MS = 1,
+} cmd_config_key_t;
+
+typedef struct
+{
+    uint8_t type;       // cmd_type_t
+    uint32_t enq_us;    // time_us_32() when it was queued
+    union
+    {
+        struct
+        {
+            uint16_t id;
+            uint8_t mask;
+            uint8_t value;
+        } led;
+        struct
+        {
+            uint16_t key; // cmd_config_key_t
+            uint32_t value;
+        } config;
+    };
+} cmd_t;
+
+typedef struct
+{
+    volatile uint32_t seq;
+    cmd_t cmd;
+} cmdq_cell_t;
+
+static cmdq_cell_t cmdq_cells[CMDQ_LEN];
+static volatile uint32_t cmdq_tail = 0; // next cell to claim, producers
+static volatile uint32_t cmdq_head = 0; // next cell to read, Core0 only
+
+// Counters. Producer side uses atomics; the rest are written by Core0 only.
+static volatile uint32_t cmdq_enqueued = 0;
+static volatile uint32_t cmdq_dropped = 0;
+static volatile uint32_t cmdq_max_depth = 0;
+static volatile uint32_t cmdq_dispatched = 0;
+static volatile uint32_t cmdq_batches = 0;
+static volatile uint32_t cmdq_lat_max_us = 0;
+static volatile uint64_t cmdq_lat_sum_us = 0;
+
+// cmdq_dispatched and cmdq_lat_sum_us change together, and a 64-bit load is two on these cores, so
+// Core1 reads the pair through this sequence count: odd while Core0 is updating it.
+static volatile uint32_t cmdq_lat_seq = 0;
+
+// Call once before Core1 starts.
+static void cmdq_init(void)
+{
+    for (uint32_t i = 0; i < CMDQ_LEN; i++)
+        cmdq_cells[i].seq = i;
+    cmdq_tail = cmdq_head = 0;
+}
+
+static inline uint32_t cmdq_depth(void)
+{
+    return cmdq_tail - cmdq_head;
+}
+
+/* ===================== PRODUCERS (any core) ===================== */
+
+// Copies *cmd into the queue and stamps it. False if the queue is full; the command is dropped.
+static bool cmdq_push(const cmd_t *cmd)
+{
+    uint32_t pos = __atomic_load_n(&cmdq_tail, __ATOMIC_RELAXED);
+    cmdq_cell_t *cell;
+
+    for (;;)
+    {
+        cell = &cmdq_cells[pos & (CMDQ_LEN - 1)];
+        int32_t dif = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&cmdq_tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (dif < 0)
+        {
+            __atomic_fetch_add(&cmdq_dropped, 1, __ATOMIC_RELAXED);
+            return false; // Core0 has not freed this cell yet: full
+        }
+        else
+            pos = __atomic_load_n(&cmdq_tail, __ATOMIC_RELAXED);
+    }
+
+    cell->cmd = *cmd;
+    cell->cmd.enq_us = time_us_32();
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    __atomic_fetch_add(&cmdq_enqueued, 1, __ATOMIC_RELAXED);
+    uint32_t depth = pos + 1 - cmdq_head;
+    if (depth > cmdq_max_depth)
+        cmdq_max_depth = depth; // a lost race here only under-reports the high-water mark
+    __sev();                    // wake Core0 if it is waiting out its poll interval
+    return true;
+}
+
+/* ===================== CONSUMER (Core0) ===================== */
+
+static bool cmdq_pop(cmd_t *out)
+{
+    uint32_t pos = cmdq_head;
+    cmdq_cell_t *cell = &cmdq_cells[pos & (CMDQ_LEN - 1)];
+
+    if ((int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos + 1)) < 0)
+        return false; // empty, or the producer is still filling it
+
+    *out = cell->cmd;
+    __atomic_store_n(&cell->seq, pos + CMDQ_LEN, __ATOMIC_RELEASE);
+    cmdq_head = pos + 1;
+
+    uint32_t lat = time_us_32() - out->enq_us;
+    __atomic_store_n(&cmdq_lat_seq, cmdq_lat_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    cmdq_dispatched++;
+    cmdq_lat_sum_us += lat;
+    __atomic_store_n(&cmdq_lat_seq, cmdq_lat_seq + 1, __ATOMIC_RELEASE);
+    if (lat > cmdq_lat_max_us)
+        cmdq_lat_max_us = lat;
+    return true;
+}
+
+// A consistent copy of the dispatch count and the latency sum, from the other core.
+static void cmdq_lat_read(uint32_t *dispatched, uint64_t *sum_us)
+{
+    uint32_t seq;
+    do
+    {
+        seq = __atomic_load_n(&cmdq_lat_seq, __ATOMIC_ACQUIRE);
+        *dispatched = cmdq_dispatched;
+        *sum_us = cmdq_lat_sum_us;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&cmdq_lat_seq, __ATOMIC_RELAXED));
+}
+
+// Sleeps up to ms, but returns as soon as a command is queued.
+static void cmdq_wait_ms(uint32_t ms)
+{
+    absolute_time_t until = make_timeout_time_ms(ms);
+    while (cmdq_depth() == 0)
+    {
+        if (best_effort_wfe_or_timeout(until))
+            break;
+    }
+}
+
+#endif
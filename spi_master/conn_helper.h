@@ -0,0 +1,256 @@
+#ifndef CONN_HELPER_H
+#define CONN_HELPER_H
+
+// This is conn_helper.h, connection bookkeeping for the Core1 HTTP server.
+// Every accepted client gets an http_conn_t from a fixed pool (no lwIP heap, no malloc) that holds its
+// request buffer and its timers. accept_callback() in http_helper.h wires up recv/sent/poll/err, so a
+// client that goes quiet, dribbles its request one byte at a time, or disappears without a FIN is
+// reaped by conn_poll() instead of pinning a PCB forever.
+//
+// Admission: HTTP_MAX_CONNS clients of any kind, plus HTTP_RESERVED_CONNS slots only a POST may keep,
+// so a dashboard full of status pollers cannot lock out a control click. Nobody knows the method at
+// accept time, so anyone can take a reserved slot; once the request is in, http_dispatch() answers a
+// non-POST 503 if the pool is still over HTTP_MAX_CONNS. When every slot is taken, a new client takes
+// the slot of a client that has not sent a complete request yet, a GET before a POST and the oldest
+// first; if everybody is already being answered, it is refused. Routed requests also get an lwIP PCB
+// priority (control above polling), which only matters if lwIP itself runs out of PCBs.
+//
+// Most responses fit in one tcp_write(). A larger one (GET /metrics) goes through conn_stream(): it
+// queues what the send buffer takes now and the rest from conn_sent() as ACKs free room, so a few KB
+// of body never needs more than a couple of segments of the small lwIP heap at once.
+
+#include "lwip/tcp.h"
+#include "lwip/sys.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HTTP_MAX_CONNS 4
+#define HTTP_RESERVED_CONNS 1 // extra slots a POST may keep, see http_dispatch()
+#define HTTP_POOL_CONNS (HTTP_MAX_CONNS + HTTP_RESERVED_CONNS)
+#define HTTP_REQ_BUF_LEN 512
+#define HTTP_POLL_INTERVAL 2          // lwIP poll ticks are 500 ms, so once a second
+#define HTTP_REQUEST_TIMEOUT_MS 3000  // whole request (headers + body) must arrive within this
+#define HTTP_IDLE_TIMEOUT_MS 5000     // no progress at all, in any state
+#define HTTP_CLOSE_RETRIES 4          // tcp_close() ERR_MEM retries before we give up and abort
+
+typedef enum
+{
+    CONN_FREE = 0,
+    CONN_RECEIVING, // waiting for a complete request
+    CONN_SENDING,   // streaming a response body, continued from conn_sent()
+    CONN_CLOSING,   // response queued but tcp_close() failed, retrying from conn_poll()
+} conn_state_t;
+
+typedef struct
+{
+    struct tcp_pcb *pcb;
+    conn_state_t state;
+    uint8_t close_tries;
+    uint16_t len; // bytes in buf
+    uint32_t opened_ms;
+    uint32_t last_ms; // last progress (data in or ACK out)
+    const char *tx;   // CONN_SENDING: body still to queue, owned by the caller of conn_stream()
+    uint16_t tx_len;
+    char buf[HTTP_REQ_BUF_LEN];
+} http_conn_t;
+
+static http_conn_t http_conns[HTTP_POOL_CONNS];
+
+// Counters, Core1 only.
+static uint16_t http_conn_active = 0;
+static uint32_t http_conn_accepted = 0;
+static uint32_t http_conn_refused = 0;
+static uint32_t http_conn_evicted = 0;
+static uint32_t http_conn_reaped = 0;
+static uint32_t http_conn_errors = 0;
+
+/* ===================== POOL ===================== */
+
+static http_conn_t *conn_alloc(struct tcp_pcb *pcb)
+{
+    for (int i = 0; i < HTTP_POOL_CONNS; i++)
+    {
+        http_conn_t *c = &http_conns[i];
+        if (c->state == CONN_FREE)
+        {
+            c->pcb = pcb;
+            c->state = CONN_RECEIVING;
+            c->close_tries = 0;
+            c->len = 0;
+            c->tx = NULL;
+            c->tx_len = 0;
+            c->opened_ms = c->last_ms = sys_now();
+            http_conn_active++;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static void conn_free(http_conn_t *c)
+{
+    if (c->state == CONN_FREE)
+        return;
+    c->state = CONN_FREE;
+    c->pcb = NULL;
+    c->tx = NULL;
+    http_conn_active--;
+}
+
+// Unhooks our callbacks so lwIP never calls back into a freed context.
+static void conn_detach(http_conn_t *c)
+{
+    struct tcp_pcb *pcb = c->pcb;
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    tcp_err(pcb, NULL);
+}
+
+// Graceful close. If lwIP has no memory for the FIN right now, stay in CONN_CLOSING and let
+// conn_poll() retry. Returns ERR_ABRT if it had to abort, which recv/poll callbacks must pass on.
+static err_t conn_close(http_conn_t *c)
+{
+    struct tcp_pcb *pcb = c->pcb;
+
+    if (tcp_close(pcb) == ERR_OK)
+    {
+        conn_detach(c);
+        conn_free(c);
+        return ERR_OK;
+    }
+
+    c->state = CONN_CLOSING;
+    if (++c->close_tries > HTTP_CLOSE_RETRIES)
+    {
+        conn_detach(c);
+        conn_free(c);
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+static void conn_abort(http_conn_t *c)
+{
+    struct tcp_pcb *pcb = c->pcb;
+    conn_detach(c);
+    conn_free(c);
+    tcp_abort(pcb);
+}
+
+// True if what has arrived of the request so far is a POST. Nothing yet counts as not a POST.
+static bool conn_is_post(const http_conn_t *c)
+{
+    return c->len >= 5 && memcmp(c->buf, "POST ", 5) == 0;
+}
+
+// Pool is full: make room by dropping a client that has not finished sending its request. A GET (or
+// a client that has sent nothing yet) goes before a POST, and the oldest first.
+static bool conn_evict_one(void)
+{
+    http_conn_t *victim = NULL;
+    for (int i = 0; i < HTTP_POOL_CONNS; i++)
+    {
+        http_conn_t *c = &http_conns[i];
+        if (c->state != CONN_RECEIVING)
+            continue;
+        if (!victim || conn_is_post(victim) > conn_is_post(c) ||
+            (conn_is_post(victim) == conn_is_post(c) && (int32_t)(c->opened_ms - victim->opened_ms) < 0))
+            victim = c;
+    }
+    if (!victim)
+        return false;
+
+    http_conn_evicted++;
+    conn_abort(victim);
+    return true;
+}
+
+// Queues as much of c->tx as the send buffer takes, one MSS per write. True once all of it is queued.
+static bool conn_stream_more(http_conn_t *c)
+{
+    struct tcp_pcb *pcb = c->pcb;
+
+    while (c->tx_len)
+    {
+        uint16_t n = tcp_sndbuf(pcb);
+        if (n > TCP_MSS)
+            n = TCP_MSS;
+        if (n > c->tx_len)
+            n = c->tx_len;
+        if (n == 0)
+            break;
+        u8_t flags = TCP_WRITE_FLAG_COPY | (n < c->tx_len ? TCP_WRITE_FLAG_MORE : 0);
+        if (tcp_write(pcb, c->tx, n, flags) != ERR_OK)
+            break; // out of heap or queue slots; conn_sent() tries again
+        c->tx += n;
+        c->tx_len -= n;
+    }
+    tcp_output(pcb);
+    return c->tx_len == 0;
+}
+
+// Sends data (which must stay valid until the connection is done with it) and keeps the connection
+// open until it has all been queued. http_dispatch() sees CONN_SENDING and leaves the close to us.
+static void conn_stream(http_conn_t *c, const char *data, uint16_t len)
+{
+    c->tx = data;
+    c->tx_len = len;
+    if (!conn_stream_more(c))
+        c->state = CONN_SENDING;
+}
+
+/* ===================== LWIP CALLBACKS ===================== */
+
+static err_t conn_poll(void *arg, struct tcp_pcb *pcb)
+{
+    http_conn_t *c = (http_conn_t *)arg;
+    if (!c)
+    {
+        tcp_abort(pcb); // orphan, should not happen
+        return ERR_ABRT;
+    }
+
+    uint32_t now = sys_now();
+
+    if (c->state == CONN_CLOSING)
+        return conn_close(c);
+
+    if ((c->state == CONN_RECEIVING && now - c->opened_ms > HTTP_REQUEST_TIMEOUT_MS) ||
+        now - c->last_ms > HTTP_IDLE_TIMEOUT_MS)
+    {
+        http_conn_reaped++;
+        conn_abort(c);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+static err_t conn_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    (void)pcb;
+    (void)len;
+    http_conn_t *c = (http_conn_t *)arg;
+    if (!c)
+        return ERR_OK;
+
+    c->last_ms = sys_now();
+    if (c->state == CONN_SENDING && conn_stream_more(c))
+        return conn_close(c);
+    return ERR_OK;
+}
+
+// lwIP has already freed the PCB when this runs; only our context is left to clean up.
+static void conn_err(void *arg, err_t err)
+{
+    (void)err;
+    http_conn_t *c = (http_conn_t *)arg;
+    http_conn_errors++;
+    if (c)
+        conn_free(c);
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef CONTROL_HELPER_H
+#define CONTROL_HELPER_H
+
+// This is control_helper.h, the LED/relay command protocol between the master and the slave.
+// The old protocol sent a toggle number in byte 2 once and forgot about it. The slave ignored a repeat
+// of the same number, so a lost frame lost the click and a second identical click did nothing.
+//
+// Now the master sends the state it wants, not a change, and tags it with a command ID:
+//   master -> slave   byte 0 = command ID (1..255, 0 = no command)
+//                     byte 1 = mask, which LEDs to set (G = bit0, Y = bit1, R = bit2, relay = bit3)
+//                     byte 2 = value for those bits
+//   slave -> master   byte 0 = ADC LSB
+//                     byte 1 = ADC bits 8..11 in the low nibble, LED state in the high nibble
+//                     byte 2 = ID of the last command the slave applied
+// Setting a bit that is already set does nothing, so the master simply resends the same frame until the
+// slave echoes the ID back. A click can no longer be lost, and two clicks never cancel each other out.
+//
+// Core1 (POST /api/control) turns each request into a CMD_LED_SET on the command queue (cmdq_helper.h)
+// and hands back its ID. Core0 merges every LED command it drains into ctl_want, so a burst of requests
+// goes out as one frame, and it keeps ctl_applied, the ID of the last request the slave confirmed. That
+// goes out with every status snapshot, so a client can see when its request ID has been applied.
+
+#include "hardware/sync.h"
+#include "cmdq_helper.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CTL_LED_MASK 0x0F
+#define CTL_ACK_POLL_MS 200 // slave loop is about 150 ms, so its echo is ready by then
+#define CTL_FAST_TRIES 10   // after that, keep resending at the normal poll interval
+
+// ctl_want layout: bits 0..7 mask, 8..15 value, 16..31 request ID (0 = nothing requested yet)
+#define CTL_WANT(id, mask, value) (((uint32_t)(id) << 16) | ((uint32_t)(value) << 8) | (mask))
+#define CTL_WANT_ID(w) ((uint16_t)((w) >> 16))
+#define CTL_WANT_MASK(w) ((uint8_t)(w))
+#define CTL_WANT_VALUE(w) ((uint8_t)((w) >> 8))
+
+static uint16_t ctl_next_id = 0;           // Core1 only
+static uint8_t ctl_asked_mask = 0;         // Core1 only, every LED ever requested
+static uint8_t ctl_asked_value = 0;        // Core1 only, and the state last requested for it
+
+static uint32_t ctl_want = 0;              // Core0 only
+static volatile uint16_t ctl_applied = 0;  // written by Core0 only
+static volatile uint32_t ctl_retries = 0;  // written by Core0 only
+static uint16_t ctl_sending = 0;           // Core0 only, request ID in flight
+static uint8_t ctl_tries = 0;              // Core0 only, frames sent for it so far
+
+// 8-bit ID on the wire for a 16-bit request ID, never 0
+static inline uint8_t ctl_wire_id(uint16_t id)
+{
+    return (uint8_t)(id % 255) + 1;
+}
+
+/* ===================== CORE1 SIDE ===================== */
+
+// Queues a change for Core0 and returns its request ID, or 0 if the command queue is full.
+static uint16_t ctl_request(uint8_t mask, uint8_t value)
+{
+    uint16_t id = ctl_next_id + 1;
+    if (id == 0)
+        id = 1;
+
+    mask &= CTL_LED_MASK;
+    cmd_t cmd = {.type = CMD_LED_SET, .led = {.id = id, .mask = mask, .value = value & mask}};
+    if (!cmdq_push(&cmd))
+        return 0;
+
+    ctl_next_id = id;
+    ctl_asked_mask |= mask;
+    ctl_asked_value = (ctl_asked_value & ~mask) | (value & mask);
+    return id;
+}
+
+// Desired state of one LED bit: the last request for it, or what the slave reported if there was none.
+static bool ctl_effective(uint8_t bit, uint8_t reported)
+{
+    return (ctl_asked_mask & bit) ? (ctl_asked_value & bit) != 0 : (reported & bit) != 0;
+}
+
+/* ===================== CORE0 SIDE ===================== */
+
+// Folds one drained CMD_LED_SET into the desired state. Bits outside its mask keep whatever an
+// earlier command asked for; bits never requested follow the slave.
+static void ctl_merge(uint16_t id, uint8_t mask, uint8_t value)
+{
+    uint8_t want_mask = CTL_WANT_MASK(ctl_want) | mask;
+    uint8_t want_value = (CTL_WANT_VALUE(ctl_want) & ~mask) | (value & mask);
+    ctl_want = CTL_WANT(id, want_mask, want_value);
+}
+
+static inline bool ctl_pending(void)
+{
+    uint32_t w = ctl_want;
+    return CTL_WANT_ID(w) != 0 && CTL_WANT_ID(w) != ctl_applied;
+}
+
+// Fills the 3-byte SPI frame for this exchange: the desired state until the slave confirms it, or
+// all zeros when there is nothing to send.
+static void ctl_next_frame(uint8_t tx[3])
+{
+    uint32_t w = ctl_want;
+
+    if (!ctl_pending())
+    {
+        tx[0] = tx[1] = tx[2] = 0;
+        return;
+    }
+    if (CTL_WANT_ID(w) != ctl_sending)
+    {
+        ctl_sending = CTL_WANT_ID(w); // a newer request replaces the one in flight
+        ctl_tries = 0;
+    }
+    else
+        ctl_retries++;
+    if (ctl_tries < UINT8_MAX)
+        ctl_tries++;
+
+    tx[0] = ctl_wire_id(CTL_WANT_ID(w));
+    tx[1] = CTL_WANT_MASK(w);
+    tx[2] = CTL_WANT_VALUE(w);
+}
+
+// Called with byte 2 of the slave's reply. The reply was loaded before this exchange, so it confirms
+// the frame sent one exchange earlier.
+static void ctl_on_reply(uint8_t ack)
+{
+    uint32_t w = ctl_want;
+    if (ctl_pending() && CTL_WANT_ID(w) == ctl_sending && ack == ctl_wire_id(ctl_sending))
+    {
+        ctl_applied = ctl_sending;
+        ctl_tries = 0;
+    }
+}
+
+// How long Core0 should wait before the next exchange.
+static inline uint32_t ctl_poll_ms(uint32_t idle_ms)
+{
+    return (ctl_pending() && ctl_tries && ctl_tries <= CTL_FAST_TRIES) ? CTL_ACK_POLL_MS : idle_ms;
+}
+
+#endif
@@ -8,10 +8,62 @@
 // like ADC values (thermistor from slave), and the state of the LEDs (red = 4, yellow = 2, green = 1,
 // or any three bit combination stuffed into an eight bit byte. I call this the accessory control byte.)
 
-// ChatGPT code:
+// The Wi-Fi driver runs in pico_cyw43_arch_lwip_threadsafe_background mode. Because cyw43_arch_init()
+// is called here, on Core1, the CYW43 interrupt and the async_context that services lwIP both live on
+// Core1: a packet is handled when its interrupt fires, not on the next pass of a 1 ms polling loop, and
+// Core1 sleeps in __wfi() when there is nothing to do.
+//
+// Anything outside an lwIP callback that touches lwIP must be wrapped in cyw43_arch_lwip_begin/end.
+// Deferred HTTP work (http_run_deferred), the periodic link check and the temperature push to the
+// ESP32 run as async_context workers, so they are serialized with the lwIP callbacks without any extra
+// locking.
+
+#define NET_HOUSEKEEPING_MS 5000
+#define ESP32_PUSH_MS 10000 // temperature to the ESP32 display
+
+static void net_deferred_work(async_context_t *context, async_when_pending_worker_t *worker)
+{
+    (void)context;
+    (void)worker;
+    http_run_deferred();
+}
+
+static async_when_pending_worker_t net_deferred_worker = {.do_work = net_deferred_work};
+
+// Safe to call from either core or from an IRQ.
+static void net_kick(void)
+{
+    async_context_set_work_pending(cyw43_arch_async_context(), &net_deferred_worker);
+}
+
+static void net_housekeeping(async_context_t *context, async_at_time_worker_t *worker)
+{
+    int link = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+    if (link <= CYW43_LINK_DOWN) // down, failed, no net or bad auth; leave an attempt in progress alone
+    {
+        printf("Wi-Fi link %d, reconnecting\n", link);
+        cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK);
+    }
+    async_context_add_at_time_worker_in_ms(context, worker, NET_HOUSEKEEPING_MS);
+}
+
+static async_at_time_worker_t net_housekeeping_worker = {.do_work = net_housekeeping};
+
+static void net_esp32_push(async_context_t *context, async_at_time_worker_t *worker)
+{
+    esp32_push_temperature();
+    async_context_add_at_time_worker_in_ms(context, worker, ESP32_PUSH_MS);
+}
+
+static async_at_time_worker_t net_esp32_push_worker = {.do_work = net_esp32_push};
+
 void core1_main(void)
 {
-    cyw43_arch_init();
+    if (cyw43_arch_init())
+    {
+        printf("cyw43_arch_init failed\n");
+        return;
+    }
     cyw43_arch_enable_sta_mode();
 
     cyw43_arch_wifi_connect_timeout_ms(
@@ -20,6 +72,13 @@ void core1_main(void)
         CYW43_AUTH_WPA2_AES_PSK,
         30000);
 
+    if (!http_routes_init())
+    {
+        printf("route table overflow\n");
+    }
+
+    cyw43_arch_lwip_begin();
+
     // start TCP server
     struct tcp_pcb *pcb = tcp_new();
     if (!pcb)
@@ -30,7 +89,7 @@ void core1_main(void)
     {
         printf("tcp_bind failed\n");
     }
-    pcb = tcp_listen(pcb);
+    pcb = tcp_listen_with_backlog(pcb, HTTP_POOL_CONNS);
     if (!pcb)
     {
         printf("tcp_listen failed\n");
@@ -38,16 +97,21 @@ void core1_main(void)
     tcp_accept(pcb, accept_callback);
     printf("Web server running at http://%s\n", ip4addr_ntoa(netif_ip4_addr(netif_default)));
 
-    sleep_ms(200);
-    printf("IP: %s\n", netif_default ? ip4addr_ntoa(netif_ip4_addr(netif_default)) : "0.0.0.0");
+    cyw43_arch_lwip_end();
+
+    async_context_t *context = cyw43_arch_async_context();
+    async_context_add_when_pending_worker(context, &net_deferred_worker);
+    async_context_add_at_time_worker_in_ms(context, &net_housekeeping_worker, NET_HOUSEKEEPING_MS);
+    async_context_add_at_time_worker_in_ms(context, &net_esp32_push_worker, ESP32_PUSH_MS);
+    http_defer_kick = net_kick;
 
-    sleep_ms(100);
     printf("MASTER READY\n");
 
+    // Everything from here on is interrupt driven. Core1 is free for other work; until there is
+    // some, it sleeps.
     while (true)
     {
-        cyw43_arch_poll(); // 🔑 THIS IS REQUIRED
-        sleep_ms(1);
+        __wfi();
     }
 }
 
@@ -0,0 +1,490 @@
+#ifndef ESP32_CLIENT_HELPER_H
+#define ESP32_CLIENT_HELPER_H
+
+// This is esp32_client_helper.h, the master's HTTP client for the ESP32 display.
+// The old esp32_send_http() opened a new connection for every message, wrote the request and closed
+// it again, so each forward paid a handshake and a FIN exchange. Now the master keeps one HTTP/1.1
+// keep-alive connection to ESP32_IP and reuses it for every /api/text forward and every /api/cmd
+// temperature push.
+//
+// Everything the master sends is a display update, and the 16x2 display shows one thing at a time, so
+// the outbound queue is one slot per kind of update (text, temperature) rather than a FIFO. A new
+// update replaces one of the same kind that has not gone out yet; a burst of twenty texts from the web
+// UI sends the first and the last, never twenty. Slots go out oldest first.
+//
+// One request is in flight at a time. It is built into the client's own tx buffer and handed to
+// tcp_write() without a copy: as much as tcp_sndbuf() allows now, the rest from the tcp_sent callback.
+// The next request goes out only when the ESP32's response has been read and every byte of this one
+// has been acked, because until then lwIP still points into tx.
+//
+// Sends are paced to the display. The ESP32 answers each update with X-Render-Ms, how long the redraw
+// took, and the next update waits at least that long after the response (ESPC_RENDER_MS until the
+// ESP32 has said). Updates arriving meanwhile just coalesce in their slots.
+//
+// A reset, a refused connect or a response that does not arrive within ESPC_TIMEOUT_MS drops the
+// connection. The request in flight is retried once on a fresh one, and reconnecting backs off from
+// ESPC_RETRY_MS up to ESPC_RETRY_MAX_MS. Pacing and backoff share one lwIP timer (espc.not_before).
+// A connection the ESP32 closes after a response is just reopened by the next request.
+//
+// Everything here runs in lwIP context: lwIP callbacks, or http_run_deferred() on the Pico.
+
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#ifndef ESP32_IP
+#define ESP32_IP "192.168.1.248"
+#endif
+#ifndef ESP32_PORT
+#define ESP32_PORT 80
+#endif
+
+#define ESPC_BODY_LEN 160
+#define ESPC_TX_MAX 320
+#define ESPC_HDR_MAX 256      // response status line and headers; the body is only counted
+#define ESPC_TIMEOUT_MS 3000  // connect, or request sent to response read
+#define ESPC_RETRY_MS 500
+#define ESPC_RETRY_MAX_MS 16000
+#define ESPC_MAX_TRIES 2
+#define ESPC_POLL_INTERVAL 2  // tcp_poll() units of 500 ms
+#define ESPC_RENDER_MS 50     // gap between updates until the ESP32 reports its own
+#define ESPC_RENDER_MAX_MS 2000
+
+typedef enum
+{
+    ESPC_DOWN = 0,   // no connection
+    ESPC_CONNECTING, // SYN sent
+    ESPC_IDLE,       // connected, nothing in flight
+    ESPC_BUSY,       // request written, waiting for acks and the response
+} espc_state_t;
+
+typedef enum
+{
+    ESPC_TEXT = 0, // POST /api/text
+    ESPC_TEMP,     // POST /api/cmd
+    ESPC_KINDS,
+} espc_kind_t;
+
+static const char *const espc_paths[ESPC_KINDS] = {"/api/text", "/api/cmd"};
+
+typedef struct
+{
+    bool pending;
+    uint32_t queued_ms; // when the oldest unsent update of this kind arrived
+    char body[ESPC_BODY_LEN];
+} espc_slot_t;
+
+static struct
+{
+    struct tcp_pcb *pcb;
+    uint8_t state;   // espc_state_t
+    uint8_t tries;   // attempts for the request in tx
+    uint8_t polls;   // tcp_poll ticks in CONNECTING or BUSY
+    bool timer_armed;
+    uint32_t not_before; // sys_now() before which nothing is sent or connected
+    uint32_t backoff_ms;
+    uint32_t render_ms;  // pacing gap, from the ESP32's X-Render-Ms
+
+    char tx[ESPC_TX_MAX]; // request in flight, or waiting for a retry; tx_len = 0 when empty
+    uint16_t tx_len;
+    uint16_t tx_written;
+    uint16_t tx_acked;
+
+    char hdr[ESPC_HDR_MAX + 1]; // response headers, lower-cased
+    uint16_t hdr_len;
+    bool in_body;
+    bool done;       // whole response read
+    bool close_after;
+    uint32_t body_left;
+    uint16_t status;
+} espc = {.backoff_ms = ESPC_RETRY_MS, .render_ms = ESPC_RENDER_MS};
+
+static espc_slot_t espc_slots[ESPC_KINDS];
+
+// Counters for /metrics.
+static uint32_t espc_connects = 0;
+static uint32_t espc_requests = 0;    // responses read
+static uint32_t espc_reused = 0;      // requests sent on a connection that had already served one
+static uint32_t espc_http_errors = 0; // responses with status >= 400
+static uint32_t espc_failures = 0;    // requests given up after ESPC_MAX_TRIES
+static uint32_t espc_refused = 0;     // updates refused: unknown path or body too long
+static uint32_t espc_coalesced = 0;   // updates replaced by a newer one before they went out
+static uint16_t espc_served = 0;      // responses on the current connection
+
+// The pcb this client last aborted, so a callback knows to return ERR_ABRT for it. A failed connection
+// never reconnects synchronously (espc_lost holds off for the backoff first), so lwIP cannot hand the same memory back within one callback.
+static struct tcp_pcb *espc_aborted = NULL;
+
+static void esp32_client_pump(void);
+
+/* ===================== CONNECTION ===================== */
+
+static void espc_timeout(void *arg)
+{
+    (void)arg;
+    espc.timer_armed = false;
+    esp32_client_pump();
+}
+
+static inline void espc_hold(uint32_t ms)
+{
+    espc.not_before = sys_now() + ms;
+}
+
+// The connection is gone (pcb already freed or detached). failed = it did not end cleanly.
+static void espc_lost(bool failed)
+{
+    espc.pcb = NULL;
+    espc.state = ESPC_DOWN;
+
+    if (espc.tx_len && espc.tries >= ESPC_MAX_TRIES)
+    {
+        espc_failures++;
+        espc.tx_len = 0;
+    }
+    if (!failed)
+    {
+        esp32_client_pump();
+        return;
+    }
+
+    espc_hold(espc.backoff_ms); // so the pump below only arms the timer, never reconnects right away
+    espc.backoff_ms = (espc.backoff_ms * 2 > ESPC_RETRY_MAX_MS) ? ESPC_RETRY_MAX_MS : espc.backoff_ms * 2;
+    esp32_client_pump();
+}
+
+static void espc_close(bool failed)
+{
+    struct tcp_pcb *pcb = espc.pcb;
+    if (!pcb)
+        return;
+
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    tcp_err(pcb, NULL);
+    if (failed || tcp_close(pcb) != ERR_OK)
+    {
+        tcp_abort(pcb);
+        espc_aborted = pcb;
+        failed = true;
+    }
+    espc_lost(failed);
+}
+
+static inline err_t espc_result(struct tcp_pcb *pcb)
+{
+    return espc_aborted == pcb ? ERR_ABRT : ERR_OK;
+}
+
+/* ===================== REQUEST ===================== */
+
+static void espc_write(void)
+{
+    struct tcp_pcb *pcb = espc.pcb;
+
+    while (espc.tx_written < espc.tx_len)
+    {
+        u16_t room = tcp_sndbuf(pcb);
+        u16_t n = espc.tx_len - espc.tx_written;
+        if (n > room)
+            n = room;
+        if (n == 0 || tcp_write(pcb, espc.tx + espc.tx_written, n, 0) != ERR_OK)
+            break; // tcp_sent will call again
+        espc.tx_written += n;
+    }
+    tcp_output(pcb);
+}
+
+static bool espc_build(const char *path, const char *body)
+{
+    int len = snprintf(espc.tx, sizeof(espc.tx),
+                       "POST %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "Content-Type: application/json\r\n"
+                       "Content-Length: %d\r\n"
+                       "\r\n"
+                       "%s",
+                       path, ESP32_IP, (int)strlen(body), body);
+    if (len < 0 || len >= (int)sizeof(espc.tx))
+        return false;
+    espc.tx_len = (uint16_t)len;
+    espc.tries = 0;
+    return true;
+}
+
+static void espc_start(void)
+{
+    espc.tx_written = espc.tx_acked = 0;
+    espc.hdr_len = 0;
+    espc.in_body = espc.done = espc.close_after = false;
+    espc.body_left = 0;
+    espc.status = 0;
+    espc.polls = 0;
+    espc.tries++;
+    espc.state = ESPC_BUSY;
+    if (espc_served)
+        espc_reused++;
+    espc_write();
+}
+
+// Done when the response is in and lwIP no longer needs tx.
+static void espc_check_done(void)
+{
+    if (espc.state != ESPC_BUSY || !espc.done || espc.tx_acked < espc.tx_len)
+        return;
+
+    espc_requests++;
+    espc_served++;
+    if (espc.status >= 400 || espc.status < 100)
+        espc_http_errors++;
+    espc.tx_len = 0;
+    espc.state = ESPC_IDLE;
+    espc.backoff_ms = ESPC_RETRY_MS;
+    espc_hold(espc.render_ms);
+
+    if (espc.close_after)
+        espc_close(false);
+    else
+        esp32_client_pump();
+}
+
+/* ===================== RESPONSE ===================== */
+
+// Headers are complete: status code, body length, and whether the ESP32 keeps the connection open.
+static void espc_parse_headers(void)
+{
+    espc.hdr[espc.hdr_len] = '\0';
+
+    unsigned status = 0;
+    if (sscanf(espc.hdr, "http/1.%*d %u", &status) == 1)
+        espc.status = (uint16_t)status;
+
+    // strtoul skips any spaces after the colon
+    const char *cl = strstr(espc.hdr, "\r\ncontent-length:");
+    espc.body_left = cl ? (uint32_t)strtoul(cl + sizeof("\r\ncontent-length:") - 1, NULL, 10) : 0;
+    espc.close_after = strstr(espc.hdr, "\r\nconnection: close") != NULL ||
+                       strncmp(espc.hdr, "http/1.0", 8) == 0;
+    const char *rm = strstr(espc.hdr, "\r\nx-render-ms:");
+    if (rm)
+    {
+        uint32_t ms = (uint32_t)strtoul(rm + sizeof("\r\nx-render-ms:") - 1, NULL, 10);
+        espc.render_ms = ms > ESPC_RENDER_MAX_MS ? ESPC_RENDER_MAX_MS : ms;
+    }
+
+    espc.in_body = true;
+    espc.done = espc.body_left == 0;
+}
+
+// Returns false if the response is malformed.
+static bool espc_feed(const char *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len && !espc.done; i++)
+    {
+        if (espc.in_body)
+        {
+            uint32_t n = len - i;
+            if (n > espc.body_left)
+                n = espc.body_left;
+            espc.body_left -= n;
+            espc.done = espc.body_left == 0;
+            break;
+        }
+        if (espc.hdr_len == ESPC_HDR_MAX)
+            return false;
+        espc.hdr[espc.hdr_len++] = (char)tolower((unsigned char)data[i]);
+        if (espc.hdr_len >= 4 && memcmp(espc.hdr + espc.hdr_len - 4, "\r\n\r\n", 4) == 0)
+            espc_parse_headers();
+    }
+    return true;
+}
+
+/* ===================== LWIP CALLBACKS ===================== */
+
+static err_t espc_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    (void)arg;
+    (void)err;
+    espc_aborted = NULL;
+
+    if (!p)
+    {
+        espc_close(espc.state != ESPC_IDLE); // clean only between requests, not in the middle of one
+        return espc_result(pcb);
+    }
+
+    bool ok = espc.state == ESPC_BUSY;
+    for (struct pbuf *q = p; q && ok; q = q->next)
+        ok = espc_feed((const char *)q->payload, q->len);
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    if (!ok)
+        espc_close(true);
+    else
+        espc_check_done();
+    return espc_result(pcb);
+}
+
+static err_t espc_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    (void)arg;
+    espc_aborted = NULL;
+
+    if (espc.state != ESPC_BUSY)
+        return ERR_OK;
+    espc.tx_acked += len;
+    espc_write();
+    espc_check_done();
+    return espc_result(pcb);
+}
+
+static err_t espc_poll(void *arg, struct tcp_pcb *pcb)
+{
+    (void)arg;
+    espc_aborted = NULL;
+
+    if (espc.state != ESPC_CONNECTING && espc.state != ESPC_BUSY)
+        return ERR_OK;
+    if (++espc.polls * ESPC_POLL_INTERVAL * 500 < ESPC_TIMEOUT_MS)
+        return ERR_OK;
+
+    printf("ESP32 %s timed out\n", espc.state == ESPC_BUSY ? "response" : "connect");
+    espc_close(true);
+    return espc_result(pcb);
+}
+
+static void espc_error(void *arg, err_t err)
+{
+    (void)arg;
+    printf("ESP32 connection error %d\n", err);
+    espc_lost(true); // lwIP has already freed the pcb
+}
+
+static err_t espc_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    (void)arg;
+    (void)err; // lwIP reports a failed connect through espc_error, never here
+    espc_aborted = NULL;
+
+    espc.state = ESPC_IDLE;
+    espc_served = 0;
+    espc_connects++;
+    esp32_client_pump();
+    return espc_result(pcb);
+}
+
+static void espc_connect(void)
+{
+    ip_addr_t ip;
+    struct tcp_pcb *pcb = tcp_new();
+
+    if (!pcb)
+    {
+        espc_lost(true);
+        return;
+    }
+    ipaddr_aton(ESP32_IP, &ip);
+
+    espc.pcb = pcb;
+    espc.state = ESPC_CONNECTING;
+    espc.polls = 0;
+    tcp_recv(pcb, espc_recv);
+    tcp_sent(pcb, espc_sent);
+    tcp_poll(pcb, espc_poll, ESPC_POLL_INTERVAL);
+    tcp_err(pcb, espc_error);
+    if (tcp_connect(pcb, &ip, ESP32_PORT, espc_connected) != ERR_OK)
+        espc_close(true);
+}
+
+/* ===================== API ===================== */
+
+static inline uint8_t esp32_client_depth(void)
+{
+    uint8_t n = 0;
+    for (int k = 0; k < ESPC_KINDS; k++)
+        n += espc_slots[k].pending;
+    return n;
+}
+
+// Stores an update for path, replacing one of the same kind that has not been sent yet. False if the
+// path is not a display update or the body does not fit.
+static bool esp32_client_queue(const char *path, const char *body)
+{
+    int kind = 0;
+    while (kind < ESPC_KINDS && strcmp(espc_paths[kind], path) != 0)
+        kind++;
+    if (kind == ESPC_KINDS || strlen(body) >= ESPC_BODY_LEN)
+    {
+        espc_refused++;
+        return false;
+    }
+
+    espc_slot_t *slot = &espc_slots[kind];
+    if (slot->pending)
+        espc_coalesced++;
+    else
+    {
+        slot->pending = true;
+        slot->queued_ms = sys_now();
+    }
+    strcpy(slot->body, body);
+    return true;
+}
+
+// Oldest pending slot into tx.
+static void espc_take(void)
+{
+    int oldest = -1;
+    for (int k = 0; k < ESPC_KINDS; k++)
+    {
+        if (espc_slots[k].pending &&
+            (oldest < 0 || (int32_t)(espc_slots[k].queued_ms - espc_slots[oldest].queued_ms) < 0))
+            oldest = k;
+    }
+    if (oldest < 0)
+        return;
+
+    espc_slots[oldest].pending = false;
+    if (!espc_build(espc_paths[oldest], espc_slots[oldest].body))
+        espc_failures++;
+}
+
+// Moves things along: connects if there is work and no connection, sends the next update if the
+// connection is free and the display has had its time. Safe to call at any time from lwIP context.
+static void esp32_client_pump(void)
+{
+    if (!espc.tx_len && !esp32_client_depth())
+        return;
+    if (espc.state != ESPC_DOWN && espc.state != ESPC_IDLE)
+        return; // connecting or busy; the callbacks pump again
+
+    int32_t wait = (int32_t)(espc.not_before - sys_now());
+    if (wait > 0)
+    {
+        if (!espc.timer_armed)
+        {
+            espc.timer_armed = true;
+            sys_timeout((u32_t)wait, espc_timeout, NULL);
+        }
+        return;
+    }
+
+    if (espc.state == ESPC_DOWN)
+        espc_connect();
+    else
+    {
+        if (!espc.tx_len)
+            espc_take();
+        if (espc.tx_len)
+            espc_start();
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef HISTORY_HELPER_H
+#define HISTORY_HELPER_H
+
+// This is history_helper.h, a fixed-size ring of timestamped samples kept in RAM on the Pico 2W.
+// Core0 pushes one sample per SPI exchange; Core1 serves them from GET /api/history?since=<seq>&max=N.
+// Every sample gets a sequence number that only ever goes up, so a client remembers the last seq it
+// saw and asks for what came after it. A fresh dashboard backfills with since=0 and then polls deltas.
+//
+// Each slot carries its own seq, written last by Core0 and checked twice by Core1 (before and after
+// copying), so a reader can never return a slot that Core0 was overwriting at the time.
+
+#include "hardware/sync.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HISTORY_LEN 512 // power of two; 512 x 3 s = about 25 minutes
+
+typedef struct
+{
+    volatile uint32_t seq; // 0 = slot never written or being rewritten
+    uint32_t t_ms;         // ms since boot
+    uint32_t raw;
+    uint16_t temperature;
+    uint8_t led;
+} history_sample_t;
+
+static history_sample_t history_ring[HISTORY_LEN];
+static volatile uint32_t history_head = 0; // seq of the newest sample, 0 = empty. Core0 only.
+
+/* ===================== CORE0 SIDE ===================== */
+
+static void history_push(uint32_t t_ms, uint32_t raw, uint16_t temperature, uint8_t led)
+{
+    uint32_t seq = history_head + 1;
+    history_sample_t *s = &history_ring[seq & (HISTORY_LEN - 1)];
+
+    s->seq = 0;
+    __dmb();
+    s->t_ms = t_ms;
+    s->raw = raw;
+    s->temperature = temperature;
+    s->led = led;
+    __dmb();
+    s->seq = seq;
+    history_head = seq;
+}
+
+/* ===================== CORE1 SIDE ===================== */
+
+static inline uint32_t history_oldest(uint32_t head)
+{
+    return (head > HISTORY_LEN) ? head - HISTORY_LEN + 1 : 1;
+}
+
+// Copies sample seq into *out. False if it has been overwritten (or is being overwritten right now).
+static bool history_read(uint32_t seq, history_sample_t *out)
+{
+    const history_sample_t *s = &history_ring[seq & (HISTORY_LEN - 1)];
+
+    if (s->seq != seq)
+        return false;
+    __dmb();
+    out->t_ms = s->t_ms;
+    out->raw = s->raw;
+    out->temperature = s->temperature;
+    out->led = s->led;
+    __dmb();
+    out->seq = seq;
+    return s->seq == seq;
+}
+
+#endif
@@ -3,216 +3,803 @@
 
 #include "lwip/tcp.h"
 #include "cJSON.h"
+#include "json_arena_helper.h"
+#include "route_helper.h"
+#include "snapshot_helper.h"
+#include "conn_helper.h"
+#include "history_helper.h"
+#include "telemetry_helper.h"
+#include "control_helper.h"
+#include "metrics_helper.h"
+#include "esp32_client_helper.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
 #include <string.h>
+#include <strings.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
 #include <stdint.h>
 
-#define ESP32_IP "192.168.1.248"
-
 /* ===================== SHARED STATE ===================== */
 
-volatile uint8_t pending_cmd = 0;
 volatile uint32_t slave_output = 0;
 volatile uint16_t current_temp_raw = 0;
 volatile uint8_t current_led_byte = 0;
 
-#define TEXT_BUF_LEN 33 // 16x2 = 32 chars + NUL
-volatile char pending_text[TEXT_BUF_LEN];
-volatile uint8_t text_pending = 0;
+/* ===================== DEFERRED WORK ===================== */
 
-/* ===================== HELPERS ===================== */
+// Talking to the ESP32 does not belong inside the recv callback that is answering the browser, so
+// forwards are queued in esp32_client_helper.h and the client is pumped by http_run_deferred(). On the
+// Pico that runs as an async_context worker (core_helper.h) and http_defer_kick wakes it; if nobody
+// installed a kick (the host load test), the client is pumped inline.
+static void (*http_defer_kick)(void) = NULL;
 
-static err_t esp32_connected(void *arg,
-                             struct tcp_pcb *pcb,
-                             err_t err)
+static void http_run_deferred(void)
 {
-    const char *req = (const char *)arg;
-
-    if (err != ERR_OK)
-    {
-        tcp_close(pcb);
-        return err;
-    }
-
-    tcp_write(pcb, req, strlen(req), TCP_WRITE_FLAG_COPY);
-    tcp_output(pcb);
-
-    tcp_close(pcb);
-    return ERR_OK;
+    esp32_client_pump();
 }
 
-void esp32_send_http(const char *req)
+static bool esp32_forward(const char *path, const char *body)
 {
-    struct tcp_pcb *pcb = tcp_new();
-    ip_addr_t ip;
+    if (!esp32_client_queue(path, body))
+        return false;
+
+    if (http_defer_kick)
+        http_defer_kick();
+    else
+        http_run_deferred();
+    return true;
+}
 
-    if (!pcb)
+// Periodic /api/cmd push of the latest temperature, shown on the ESP32's display. Called from the
+// Core1 housekeeping timer; nothing is sent before Core0 has published a first sample.
+static void esp32_push_temperature(void)
+{
+    if (status_version == 0)
         return;
 
-    ipaddr_aton(ESP32_IP, &ip);
-
-    tcp_arg(pcb, (void *)req);
-    tcp_connect(pcb, &ip, 80, esp32_connected);
+    int tf = current_temp_raw;
+    char body[32];
+    snprintf(body, sizeof(body), "{\"tf\":%d,\"tc\":%d}", tf, (tf - 32) * 5 / 9);
+    esp32_forward("/api/cmd", body);
 }
 
-static void send_empty_200(struct tcp_pcb *pcb)
-{
-    const char *resp =
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Length: 0\r\n"
-        "Connection: close\r\n\r\n";
+// Status code of the response to the request being dispatched, for /metrics. Every send_* helper
+// sets it, so a handler never has to.
+static uint16_t http_status_sent = 0;
 
-    tcp_write(pcb, resp, strlen(resp), TCP_WRITE_FLAG_COPY);
+static void send_empty_status(struct tcp_pcb *pcb, const char *status)
+{
+    http_status_sent = (uint16_t)atoi(status);
+    char resp[96];
+    int len = snprintf(resp, sizeof(resp),
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Length: 0\r\n"
+                       "Connection: close\r\n\r\n",
+                       status);
+
+    tcp_write(pcb, resp, len, TCP_WRITE_FLAG_COPY);
     tcp_output(pcb);
 }
 
-static void send_json_status(struct tcp_pcb *pcb)
+static void send_empty_200(struct tcp_pcb *pcb)
 {
-    char body[192];
-    char header[256];
-
-    int body_len = snprintf(body, sizeof(body),
-                            "{"
-                            "\"raw\":%u,"
-                            "\"temperature\":%u,"
-                            "\"led\":%u,"
-                            "\"timestamp\":%lu"
-                            "}",
-                            slave_output,
-                            current_temp_raw,
-                            current_led_byte,
-                            (unsigned long)time(NULL));
+    send_empty_status(pcb, "200 OK");
+}
 
+static void send_json_body(struct tcp_pcb *pcb, const char *status, const char *body, int body_len)
+{
+    http_status_sent = (uint16_t)atoi(status);
+    char header[128];
     int header_len = snprintf(header, sizeof(header),
-                              "HTTP/1.1 200 OK\r\n"
+                              "HTTP/1.1 %s\r\n"
                               "Content-Type: application/json\r\n"
                               "Content-Length: %d\r\n"
                               "Connection: close\r\n\r\n",
-                              body_len);
+                              status, body_len);
 
-    tcp_write(pcb, header, header_len, TCP_WRITE_FLAG_COPY);
+    tcp_write(pcb, header, header_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
     tcp_write(pcb, body, body_len, TCP_WRITE_FLAG_COPY);
     tcp_output(pcb);
 }
 
-/* ===================== HTTP HANDLER ===================== */
+// Machine clients ask for the packed form (telemetry_helper.h) with an Accept header or ?fmt=bin.
+static bool wants_binary(const http_request_t *req)
+{
+    uint16_t vlen;
+    const char *fmt = http_query_param(req, "fmt", &vlen);
+    if (fmt)
+        return vlen == 3 && memcmp(fmt, "bin", 3) == 0;
+    return http_accepts(req, TELEMETRY_CONTENT_TYPE);
+}
 
-static err_t http_handler(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+// Core0 has already formatted the whole response (see snapshot_helper.h); all we do is pin the live
+// slot and hand it to lwIP. tcp_write() copies into the segment (LWIP_NETIF_TX_SINGLE_PBUF forces the
+// copy anyway), so the slot can be released straight away.
+static void send_status(struct tcp_pcb *pcb, bool binary)
 {
-    (void)arg;
-    (void)err;
+    uint8_t slot;
+    const status_snapshot_t *snap = status_snapshot_acquire(&slot);
+    http_status_sent = 200;
+
+    if (binary)
+        tcp_write(pcb, snap->bin, snap->bin_len, TCP_WRITE_FLAG_COPY);
+    else
+        tcp_write(pcb, snap->buf, snap->len, TCP_WRITE_FLAG_COPY);
+    status_snapshot_release(slot);
+    tcp_output(pcb);
+}
 
-    if (!p)
+/* ===================== JSON FIELDS ===================== */
+
+// Most routes want one member of a small object. json_field() runs the body through cJSON's streaming
+// parser and stops as soon as that member has been seen: one pass, no tree, nothing allocated. Names
+// match case-insensitively, as cJSON_GetObjectItem() does. control_route, with its nested "changes",
+// still builds a tree (in the arena, json_arena_helper.h).
+typedef struct
+{
+    const char *name;
+    bool found;
+    int type;      // cJSON_Number, cJSON_String, ...
+    double number; // cJSON_Number
+    char *str;     // cJSON_String, copied here and cut to str_size - 1
+    size_t str_size;
+} json_field_t;
+
+static cJSON_SAX http_sax; // Core1 only
+
+static cJSON_bool json_field_event(cJSON_SAX_Event event, const cJSON *item, size_t depth, void *user)
+{
+    json_field_t *f = (json_field_t *)user;
+
+    if (event == cJSON_SAX_Key || event == cJSON_SAX_EndObject || event == cJSON_SAX_EndArray)
+        return true;
+    if (depth == 0)
+        return event == cJSON_SAX_StartObject; // the body is not an object: nothing to find
+    if (depth != 1 || strcasecmp(item->string, f->name) != 0)
+        return true;
+
+    f->found = true;
+    f->type = item->type;
+    f->number = item->valuedouble;
+    if (item->type == cJSON_String && f->str)
     {
-        tcp_close(pcb);
-        return ERR_OK;
+        strncpy(f->str, item->valuestring, f->str_size - 1);
+        f->str[f->str_size - 1] = '\0';
     }
+    return false; // got it, skip the rest
+}
 
-    char req[512];
-    int len = (p->tot_len < sizeof(req) - 1) ? p->tot_len : sizeof(req) - 1;
-    pbuf_copy_partial(p, req, len, 0);
-    req[len] = '\0';
+static bool json_field(const http_request_t *req, json_field_t *f)
+{
+    f->found = false;
+    cJSON_SAX_Init(&http_sax, json_field_event, f);
+    cJSON_SAX_Feed(&http_sax, req->body, req->body_len);
+    cJSON_SAX_Finish(&http_sax);
+    return f->found;
+}
 
-    tcp_recved(pcb, p->tot_len);
-    pbuf_free(p);
+// Writes s into out as the inside of a JSON string. Returns its length, or -1 if it does not fit in
+// size bytes with the NUL.
+static int json_escape(char *out, size_t size, const char *s)
+{
+    size_t n = 0;
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        char esc[8];
+        size_t len;
+        if (c == '"' || c == '\\')
+            len = (size_t)snprintf(esc, sizeof(esc), "\\%c", c);
+        else if (c < 0x20)
+            len = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", c);
+        else
+        {
+            esc[0] = (char)c;
+            len = 1;
+        }
+        if (n + len >= size)
+            return -1;
+        memcpy(out + n, esc, len);
+        n += len;
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+/* ===================== ROUTE HANDLERS ===================== */
 
-    /* ---------- GET /api/status ---------- */
-    if (strncmp(req, "GET /api/status", 15) == 0)
+static void status_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    send_status(pcb, wants_binary(req));
+}
+
+// POST /api/control, any one of:
+//   {"led":n}                                 toggle LED n (1 = G, 2 = Y, 3 = R, 4 = relay), as before
+//   {"mask":m,"value":v}                      set the bits in m to v; {"value":v} alone sets all four
+//   {"changes":[{"led":n,"on":true},...]}     several LEDs at once
+// Answers 202 with the request ID. It is applied once /api/status reports "applied" equal to that ID.
+static void control_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    cJSON *json = cJSON_Parse(req->body);
+    if (!json)
     {
-        send_json_status(pcb);
-        tcp_close(pcb);
-        return ERR_OK;
+        send_empty_status(pcb, "400 Bad Request");
+        return;
     }
 
-    /* ---------- POST /api/control ---------- */
-    if (strncmp(req, "POST /api/control", 17) == 0)
+    uint8_t mask = 0;
+    uint8_t value = 0;
+    uint8_t reported = current_led_byte;
+
+    cJSON *led = cJSON_GetObjectItem(json, "led");
+    cJSON *bits = cJSON_GetObjectItem(json, "value");
+    cJSON *changes = cJSON_GetObjectItem(json, "changes");
+
+    if (cJSON_IsNumber(led) && led->valueint >= 1 && led->valueint <= 4)
+    {
+        mask = 1 << (led->valueint - 1);
+        value = ctl_effective(mask, reported) ? 0 : mask;
+    }
+    else if (cJSON_IsNumber(bits))
     {
-        char *body = strstr(req, "\r\n\r\n");
-        if (body)
+        cJSON *m = cJSON_GetObjectItem(json, "mask");
+        mask = cJSON_IsNumber(m) ? (uint8_t)m->valueint : CTL_LED_MASK;
+        value = (uint8_t)bits->valueint;
+    }
+    else if (cJSON_IsArray(changes))
+    {
+        cJSON *c;
+        cJSON_ArrayForEach(c, changes)
         {
-            body += 4;
-            cJSON *json = cJSON_Parse(body);
-            if (json)
-            {
-                cJSON *led = cJSON_GetObjectItem(json, "led");
-                if (cJSON_IsNumber(led))
-                {
-                    pending_cmd = led->valueint & 0xFF;
-                }
-                cJSON_Delete(json);
-            }
+            cJSON *n = cJSON_GetObjectItem(c, "led");
+            cJSON *on = cJSON_GetObjectItem(c, "on");
+            if (!cJSON_IsNumber(n) || n->valueint < 1 || n->valueint > 4 || !cJSON_IsBool(on))
+                continue;
+            uint8_t bit = 1 << (n->valueint - 1);
+            mask |= bit;
+            value = cJSON_IsTrue(on) ? (value | bit) : (value & ~bit);
         }
+    }
+    cJSON_Delete(json);
+
+    mask &= CTL_LED_MASK;
+    if (!mask)
+    {
+        send_empty_status(pcb, "400 Bad Request");
+        return;
+    }
+
+    uint16_t id = ctl_request(mask, value);
+    if (!id)
+    {
+        send_empty_status(pcb, "503 Service Unavailable"); // command queue full
+        return;
+    }
+
+    char body[64];
+    int len = snprintf(body, sizeof(body), "{\"id\":%u,\"mask\":%u,\"value\":%u}",
+                       id, mask, value & mask);
+    send_json_body(pcb, "202 Accepted", body, len);
+}
+
+#define TEXT_BODY_MAX 128 // /api/text's max_body, so the text always fits in text_route's copy
+
+static void text_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    /* 1. Find "text" in the body */
+    char text[TEXT_BODY_MAX];
+    json_field_t txt = {.name = "text", .str = text, .str_size = sizeof(text)};
+    if (!json_field(req, &txt) || txt.type != cJSON_String)
+    {
+        printf("Bad JSON or missing text field\n");
+        send_empty_status(pcb, "400 Bad Request");
+        return;
+    }
+
+    /* 2. Build POST body for ESP32, escaped again. Text only ever reaches its display over HTTP, never
+     * the UART link. One that escapes to more than a queue slot holds is refused, not cut. */
+    char esp_body[ESPC_BODY_LEN];
+    int n = snprintf(esp_body, sizeof(esp_body), "{\"text\":\"");
+    int esc = json_escape(esp_body + n, sizeof(esp_body) - n - 2, text); // room for "}
+    if (esc < 0)
+    {
+        send_empty_status(pcb, "413 Payload Too Large");
+        return;
+    }
+    memcpy(esp_body + n + esc, "\"}", 3);
 
+    /* 3. Queue for the ESP32's keep-alive connection. The answer only says whether the update was
+     * queued (200) or refused (503); whether the ESP32 then displays it is not known here. */
+    if (esp32_forward("/api/text", esp_body))
         send_empty_200(pcb);
-        tcp_close(pcb);
-        return ERR_OK;
+    else
+        send_empty_status(pcb, "503 Service Unavailable");
+}
+
+// POST /api/config {"poll_ms":n} - how often Core0 talks to the slave when nothing is pending.
+static void config_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    json_field_t poll = {.name = "poll_ms"};
+    bool ok = json_field(req, &poll) && poll.type == cJSON_Number && poll.number >= 0;
+    cmd_t cmd = {.type = CMD_CONFIG, .config = {.key = CFG_POLL_MS}};
+    if (ok) // converting a double that does not fit is undefined; Core0 clamps to POLL_MS_MAX
+        cmd.config.value = poll.number >= UINT32_MAX ? UINT32_MAX : (uint32_t)poll.number;
+
+    if (!ok)
+        send_empty_status(pcb, "400 Bad Request");
+    else if (!cmdq_push(&cmd))
+        send_empty_status(pcb, "503 Service Unavailable");
+    else
+        send_empty_status(pcb, "202 Accepted");
+}
+
+// POST /api/read - exchange with the slave now. Watch "seq" in /api/status for the result.
+static void read_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    (void)req;
+    cmd_t cmd = {.type = CMD_READ};
+    send_empty_status(pcb, cmdq_push(&cmd) ? "202 Accepted" : "503 Service Unavailable");
+}
+
+// GET /api/queue - command queue counters.
+static void queue_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    (void)req;
+    uint32_t dispatched;
+    uint64_t lat_sum_us;
+    cmdq_lat_read(&dispatched, &lat_sum_us);
+    char body[224];
+    int len = snprintf(body, sizeof(body),
+                       "{\"depth\":%lu,\"max_depth\":%lu,\"enqueued\":%lu,\"dropped\":%lu,"
+                       "\"dispatched\":%lu,\"batches\":%lu,\"lat_avg_us\":%lu,\"lat_max_us\":%lu}",
+                       (unsigned long)cmdq_depth(), (unsigned long)cmdq_max_depth,
+                       (unsigned long)cmdq_enqueued, (unsigned long)cmdq_dropped,
+                       (unsigned long)dispatched, (unsigned long)cmdq_batches,
+                       (unsigned long)(dispatched ? lat_sum_us / dispatched : 0),
+                       (unsigned long)cmdq_lat_max_us);
+    send_json_body(pcb, "200 OK", body, len);
+}
+
+// GET /api/history?since=<seq>&max=N
+// Returns samples with seq > since, oldest first, at most N of them and never more than fits in one
+// segment. "next" is the cursor for the following call; "more" says there is more to fetch right away;
+// "gap" says samples between since and the first one returned have already been overwritten (or the
+// Pico restarted and the client's cursor is from before that). With ?fmt=bin or an octet-stream Accept
+// header the same answer goes out in the packed layout from telemetry_helper.h, 12 bytes per sample.
+#define HISTORY_RESP_MAX 1400 // one TCP_MSS with room for the headers
+#define HISTORY_MAX_DEFAULT 64
+// The JSON tail, "],\"head\":,\"next\":,\"now\":,\"more\":,\"gap\":}" is 40 characters, plus three
+// 10-digit numbers, two "false" and the NUL: 81 bytes at most
+#define HISTORY_TAIL_MAX 96
+
+static char history_body[HISTORY_RESP_MAX];
+
+static void history_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    bool binary = wants_binary(req);
+    uint32_t since = http_query_uint(req, "since", 0);
+    uint32_t max = http_query_uint(req, "max", HISTORY_MAX_DEFAULT);
+    uint32_t head = history_head;
+    uint32_t oldest = history_oldest(head);
+    bool gap = false;
+
+    if (since > head)
+    {
+        since = 0; // cursor from a previous boot
+        gap = true;
     }
+    uint32_t seq = since + 1;
+    if (head && seq < oldest)
+    {
+        gap = gap || since != 0;
+        seq = oldest;
+    }
+
+    int len = 0;
+    int cap = sizeof(history_body) - HISTORY_TAIL_MAX; // keep room for the closing fields
+    uint32_t first = seq;
+    uint32_t next = since;
+    uint32_t count = 0;
 
-    /* ---------- POST /api/text ---------- */
-    if (strstr(req, "POST /api/text") != NULL)
+    if (binary)
+        len = TELEMETRY_HISTORY_HEADER_LEN; // filled in once count is known
+    else
+        len += snprintf(history_body + len, cap - len, "{\"samples\":[");
+
+    for (; seq <= head && count < max; seq++)
     {
+        history_sample_t s;
+        if (!history_read(seq, &s))
+        {
+            // Overwritten under us. Samples must stay consecutive for the binary form, so skip only
+            // ahead of the first one; past that, stop here and let the next call report the gap.
+            gap = true;
+            if (count)
+                break;
+            first = seq + 1;
+            continue;
+        }
 
-        /* 1. Extract body from incoming request */
-        char *body = strstr(req, "\r\n\r\n");
-        if (!body)
+        int n;
+        if (binary)
         {
-            printf("Body empty\n");
-            send_empty_200(pcb);
-            tcp_close(pcb);
-            return ERR_OK;
+            if (len + TELEMETRY_HISTORY_SAMPLE_LEN > cap)
+                break;
+            n = telemetry_history_sample((uint8_t *)history_body + len, s.t_ms, s.raw, s.temperature, s.led);
+        }
+        else
+        {
+            n = snprintf(history_body + len, cap - len, "%s[%lu,%lu,%lu,%u,%u]",
+                         count ? "," : "",
+                         (unsigned long)s.seq, (unsigned long)s.t_ms, (unsigned long)s.raw,
+                         s.temperature, s.led);
+            if (n >= cap - len)
+                break; // full; the client picks up from next
         }
-        body += 4;
+        len += n;
+        next = seq;
+        count++;
+    }
 
-        /* 2. Parse JSON */
-        cJSON *json = cJSON_Parse(body);
-        if (!json)
+    if (binary)
+        telemetry_history_header((uint8_t *)history_body,
+                                 (next < head ? TELEMETRY_FLAG_MORE : 0) | (gap ? TELEMETRY_FLAG_GAP : 0),
+                                 (uint16_t)count, count ? first : since + 1, head, sys_now());
+    else
+    {
+        int n = snprintf(history_body + len, sizeof(history_body) - len,
+                         "],\"head\":%lu,\"next\":%lu,\"now\":%lu,\"more\":%s,\"gap\":%s}",
+                         (unsigned long)head, (unsigned long)next, (unsigned long)sys_now(),
+                         next < head ? "true" : "false", gap ? "true" : "false");
+        if (n < 0 || n >= (int)sizeof(history_body) - len)
         {
-            printf("Bad JSON\n");
-            send_empty_200(pcb);
-            tcp_close(pcb);
-            return ERR_OK;
+            // Cannot happen with HISTORY_TAIL_MAX reserved, but never send a cut-off body
+            send_empty_status(pcb, "500 Internal Server Error");
+            return;
+        }
+        len += n;
+    }
+
+    char header[128];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: %s\r\n"
+                              "Content-Length: %d\r\n"
+                              "Connection: close\r\n\r\n",
+                              binary ? TELEMETRY_CONTENT_TYPE : "application/json",
+                              len);
+
+    http_status_sent = 200;
+    tcp_write(pcb, header, header_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+    tcp_write(pcb, history_body, len, TCP_WRITE_FLAG_COPY);
+    tcp_output(pcb);
+}
+
+// GET /metrics - Prometheus text format. The body is built into metrics_body and streamed from there
+// (conn_stream), so only one scrape can be in flight; a second one gets a 503.
+#define METRICS_BODY_MAX 16384 // about 10 KB today with the lwIP pools and the UART link
+
+static char metrics_body[METRICS_BODY_MAX];
+static const char *const metrics_status_class[6] = {"none", "1xx", "2xx", "3xx", "4xx", "5xx"};
+static route_table_t http_route_table; // compiled from http_routes[] below
+
+static void metrics_route(struct tcp_pcb *pcb, const http_request_t *req)
+{
+    (void)req;
+    http_conn_t *c = (http_conn_t *)pcb->callback_arg;
+
+    for (int i = 0; i < HTTP_POOL_CONNS; i++)
+    {
+        if (http_conns[i].state == CONN_SENDING && http_conns[i].tx >= metrics_body &&
+            http_conns[i].tx <= metrics_body + METRICS_BODY_MAX)
+        {
+            send_empty_status(pcb, "503 Service Unavailable");
+            return;
         }
+    }
 
-        cJSON *txt = cJSON_GetObjectItem(json, "text");
-        if (!cJSON_IsString(txt))
+    metrics_out_t m = {.buf = metrics_body, .cap = sizeof(metrics_body)};
+    char labels[64];
+
+    /* Core0: SPI engine */
+    metrics_counter(&m, "pico_spi_transactions_total", "SPI exchanges with the slave.", "{core=\"0\"}",
+                    metrics_core0.spi_transactions);
+    metrics_counter(&m, "pico_spi_decode_errors_total", "SPI replies that could not be decoded.",
+                    "{core=\"0\"}", metrics_core0.spi_decode_errors);
+    metrics_counter(&m, "pico_spi_command_retries_total", "LED command frames resent before the slave echoed.",
+                    "{core=\"0\"}", ctl_retries);
+    metrics_histogram(&m, "pico_loop_seconds", "Core0 main loop pass, without the poll wait.", "0",
+                      &metrics_core0.loop_us);
+    metrics_histogram(&m, "pico_spi_seconds", "One SPI exchange with the slave.", "0", &metrics_core0.spi_us);
+
+    /* Command queue */
+    metrics_gauge(&m, "pico_cmdq_depth", "Commands waiting for Core0.", "", cmdq_depth());
+    metrics_counter(&m, "pico_cmdq_enqueued_total", "Commands queued.", "", cmdq_enqueued);
+    metrics_counter(&m, "pico_cmdq_dropped_total", "Commands refused because the queue was full.", "",
+                    cmdq_dropped);
+    metrics_counter(&m, "pico_cmdq_dispatched_total", "Commands drained by Core0.", "{core=\"0\"}",
+                    cmdq_dispatched);
+
+    /* Core1: HTTP */
+    metrics_header(&m, "pico_http_requests_total", "counter", "HTTP requests by route and status class.");
+    for (int r = 0; r <= METRICS_MAX_ROUTES; r++)
+    {
+        const char *path = r < http_route_table.count ? http_route_table.routes[r].path
+                           : r == METRICS_MAX_ROUTES      ? "unmatched"
+                                                          : NULL;
+        if (!path)
+            continue;
+        for (int cls = 0; cls < 6; cls++)
+        {
+            if (!metrics_core1.http_requests[r][cls])
+                continue;
+            snprintf(labels, sizeof(labels), "{core=\"1\",route=\"%s\",code=\"%s\"}", path,
+                     metrics_status_class[cls]);
+            metrics_value(&m, "pico_http_requests_total", labels, metrics_core1.http_requests[r][cls]);
+        }
+    }
+    metrics_histogram(&m, "pico_http_seconds", "Complete request to response queued.", "1",
+                      &metrics_core1.http_us);
+
+    metrics_gauge(&m, "pico_http_connections", "Open HTTP connections.", "{core=\"1\"}", http_conn_active);
+    metrics_counter(&m, "pico_http_connections_accepted_total", "Connections accepted.", "{core=\"1\"}",
+                    http_conn_accepted);
+    metrics_counter(&m, "pico_http_connections_refused_total", "Connections refused, pool full or reserved slot.",
+                    "{core=\"1\"}", http_conn_refused);
+    metrics_counter(&m, "pico_http_connections_evicted_total", "Slow clients dropped to make room.",
+                    "{core=\"1\"}", http_conn_evicted);
+    metrics_counter(&m, "pico_http_connections_reaped_total", "Connections timed out.", "{core=\"1\"}",
+                    http_conn_reaped);
+    metrics_counter(&m, "pico_http_connections_errors_total", "Connections reset or aborted by lwIP.",
+                    "{core=\"1\"}", http_conn_errors);
+
+    /* ESP32 client */
+    metrics_counter(&m, "pico_esp32_connects_total", "Connections opened to the ESP32.", "{core=\"1\"}",
+                    espc_connects);
+    metrics_counter(&m, "pico_esp32_requests_total", "Responses read from the ESP32.", "{core=\"1\"}",
+                    espc_requests);
+    metrics_counter(&m, "pico_esp32_requests_reused_total", "Requests sent on an already used connection.",
+                    "{core=\"1\"}", espc_reused);
+    metrics_counter(&m, "pico_esp32_http_errors_total", "ESP32 responses with an error status.",
+                    "{core=\"1\"}", espc_http_errors);
+    metrics_counter(&m, "pico_esp32_failures_total", "Requests given up after retrying.", "{core=\"1\"}",
+                    espc_failures);
+    metrics_counter(&m, "pico_esp32_refused_total", "Display updates refused, not sendable.", "{core=\"1\"}",
+                    espc_refused);
+    metrics_counter(&m, "pico_esp32_coalesced_total", "Display updates replaced by a newer one before sending.",
+                    "{core=\"1\"}", espc_coalesced);
+    metrics_gauge(&m, "pico_esp32_queue_depth", "Display updates waiting to be sent.", "{core=\"1\"}",
+                  esp32_client_depth());
+    metrics_gauge(&m, "pico_esp32_render_ms", "Pacing gap between display updates, from the ESP32.",
+                  "{core=\"1\"}", espc.render_ms);
+
+#ifdef UART_LINK_HELPER_H // firmware only; the host load test has no UART
+    /* UART link to the ESP32 */
+    metrics_gauge(&m, "pico_link_baud", "UART link baud rate.", "{core=\"0\"}", link_baud);
+    metrics_counter(&m, "pico_link_tx_frames_total", "Frames queued for the ESP32.", "{core=\"0\"}",
+                    link_tx_frames);
+    metrics_counter(&m, "pico_link_tx_bytes_total", "Bytes queued for the ESP32.", "{core=\"0\"}",
+                    link_tx_bytes);
+    metrics_counter(&m, "pico_link_tx_dropped_total", "Frames dropped, TX ring full.", "{core=\"0\"}",
+                    link_tx_dropped);
+    metrics_counter(&m, "pico_link_tx_stalls_total", "Times TX waited for the ESP32's ready line.",
+                    "{core=\"0\"}", link_tx_stalls);
+    metrics_gauge(&m, "pico_link_esp32_ready", "ESP32 ready line, 1 = can take more frames.", "",
+                  gpio_get(link_ready_pin));
+    metrics_counter(&m, "pico_link_rx_frames_total", "Valid frames from the ESP32.", "{core=\"0\"}",
+                    link_rx.frames);
+    metrics_counter(&m, "pico_link_rx_errors_total", "Frames from the ESP32 that failed CRC or framing.",
+                    "{core=\"0\"}", link_rx.crc_errors + link_rx.framing_errors);
+    metrics_counter(&m, "pico_link_peer_frames_total", "Frames the ESP32 reports it received.", "",
+                    link_peer_frames);
+    metrics_counter(&m, "pico_link_peer_errors_total", "Frames the ESP32 reports failed CRC.", "",
+                    link_peer_crc_errors);
+    metrics_counter(&m, "pico_link_peer_lost_total", "Frames the ESP32 reports missing by seq.", "",
+                    link_peer_lost);
+#endif
+
+    /* Memory */
+    metrics_gauge(&m, "pico_uptime_seconds", "Time since boot.", "", sys_now() / 1000);
+#if PICO_ON_DEVICE
+    metrics_gauge(&m, "pico_heap_free_bytes", "Free C heap.", "", metrics_heap_free());
+#endif
+    metrics_gauge(&m, "pico_json_arena_max_bytes", "cJSON arena high-water mark.", "{core=\"1\"}",
+                  json_arena_high);
+    metrics_gauge(&m, "pico_json_arena_size_bytes", "cJSON arena size.", "", JSON_ARENA_SIZE);
+    metrics_counter(&m, "pico_json_arena_overflows_total", "cJSON allocations refused, arena full.",
+                    "{core=\"1\"}", json_arena_overflows);
+#if LWIP_STATS && MEM_STATS
+    metrics_gauge(&m, "pico_lwip_mem_used_bytes", "lwIP heap in use.", "", lwip_stats.mem.used);
+    metrics_gauge(&m, "pico_lwip_mem_max_bytes", "lwIP heap high-water mark.", "", lwip_stats.mem.max);
+    metrics_gauge(&m, "pico_lwip_mem_avail_bytes", "lwIP heap size.", "", lwip_stats.mem.avail);
+    metrics_counter(&m, "pico_lwip_mem_errors_total", "lwIP heap allocation failures.", "",
+                    lwip_stats.mem.err);
+#endif
+#if LWIP_STATS && MEMP_STATS
+    metrics_header(&m, "pico_lwip_memp_used", "gauge", "lwIP pool entries in use (includes PBUF pools).");
+    for (int i = 0; i < MEMP_MAX; i++)
+    {
+        snprintf(labels, sizeof(labels), "{pool=\"%s\"}", lwip_stats.memp[i]->name);
+        metrics_value(&m, "pico_lwip_memp_used", labels, lwip_stats.memp[i]->used);
+    }
+    metrics_header(&m, "pico_lwip_memp_max", "gauge", "lwIP pool high-water marks.");
+    for (int i = 0; i < MEMP_MAX; i++)
+    {
+        snprintf(labels, sizeof(labels), "{pool=\"%s\"}", lwip_stats.memp[i]->name);
+        metrics_value(&m, "pico_lwip_memp_max", labels, lwip_stats.memp[i]->max);
+    }
+    metrics_header(&m, "pico_lwip_memp_errors_total", "counter", "lwIP pool allocation failures.");
+    for (int i = 0; i < MEMP_MAX; i++)
+    {
+        snprintf(labels, sizeof(labels), "{pool=\"%s\"}", lwip_stats.memp[i]->name);
+        metrics_value(&m, "pico_lwip_memp_errors_total", labels, lwip_stats.memp[i]->err);
+    }
+#endif
+
+    if (m.overflow)
+    {
+        send_empty_status(pcb, "500 Internal Server Error"); // METRICS_BODY_MAX is too small
+        return;
+    }
+
+    char header[128];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %d\r\n"
+                              "Connection: close\r\n\r\n",
+                              m.len);
+    http_status_sent = 200;
+    tcp_write(pcb, header, header_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+    conn_stream(c, metrics_body, (uint16_t)m.len);
+}
+
+/* ===================== ROUTE TABLE ===================== */
+
+// One line per endpoint. Exact paths are hashed at boot (route_table_compile), so adding routes here
+// does not slow down dispatch. max_body is enforced before the handler runs. prio is the lwIP PCB
+// priority once routed: when PCBs run out, lwIP kills the lowest first, so polling goes before control.
+static const http_route_t http_routes[] = {
+    ROUTE(HTTP_GET, ROUTE_EXACT, "/api/status", 0, TCP_PRIO_MIN, status_route),
+    ROUTE(HTTP_GET, ROUTE_EXACT, "/api/history", 0, TCP_PRIO_MIN, history_route),
+    ROUTE(HTTP_POST, ROUTE_EXACT, "/api/control", JSON_ARENA_BODY_MAX, TCP_PRIO_MAX, control_route),
+    ROUTE(HTTP_POST, ROUTE_EXACT, "/api/text", TEXT_BODY_MAX, TCP_PRIO_MAX, text_route),
+    ROUTE(HTTP_POST, ROUTE_EXACT, "/api/config", 64, TCP_PRIO_MAX, config_route),
+    ROUTE(HTTP_POST, ROUTE_EXACT, "/api/read", 0, TCP_PRIO_MAX, read_route),
+    ROUTE(HTTP_GET, ROUTE_EXACT, "/api/queue", 0, TCP_PRIO_MIN, queue_route),
+    ROUTE(HTTP_GET, ROUTE_EXACT, "/metrics", 0, TCP_PRIO_MIN, metrics_route),
+};
+_Static_assert(sizeof(http_routes) / sizeof(http_routes[0]) <= METRICS_MAX_ROUTES, "raise METRICS_MAX_ROUTES");
+
+// Boot-time setup of the server's tables, route index and cJSON's arena.
+static bool http_routes_init(void)
+{
+    json_arena_init();
+    return route_table_compile(&http_route_table, http_routes,
+                               sizeof(http_routes) / sizeof(http_routes[0]));
+}
+
+/* ===================== HTTP HANDLER ===================== */
+
+// Per-route request count by status class, and the time from complete request to queued response.
+static void http_count(const http_route_t *route, uint32_t t0)
+{
+    int r = route ? (int)(route - http_route_table.routes) : METRICS_MAX_ROUTES;
+    int cls = http_status_sent / 100;
+    metrics_core1.http_requests[r][cls < 6 ? cls : 0]++;
+    metrics_observe(&metrics_core1.http_us, time_us_32() - t0);
+}
+
+// Runs once a complete request is in c->buf. Ends with the connection closing, or streaming (see
+// conn_stream) and closing once the body is out.
+static err_t http_dispatch(http_conn_t *c)
+{
+    struct tcp_pcb *pcb = c->pcb;
+    http_request_t req;
+    const http_route_t *route = NULL;
+    uint32_t t0 = time_us_32();
+
+    http_status_sent = 0;
+    if (!http_parse_request(c->buf, c->len, &req))
+    {
+        send_empty_status(pcb, "400 Bad Request");
+        http_count(NULL, t0);
+        return conn_close(c);
+    }
+
+    // A reserved slot is for POSTs: anything else waits for one of the HTTP_MAX_CONNS general slots
+    if (req.method != HTTP_POST && http_conn_active > HTTP_MAX_CONNS)
+    {
+        http_conn_refused++;
+        send_empty_status(pcb, "503 Service Unavailable");
+        http_count(NULL, t0);
+        return conn_close(c);
+    }
+
+    switch (route_table_find(&http_route_table, req.method, req.path, req.path_len, &route))
+    {
+    case ROUTE_FOUND:
+        tcp_setprio(pcb, route->prio);
+        if (req.content_length > route->max_body || req.body_len > route->max_body)
+            send_empty_status(pcb, "413 Payload Too Large");
+        else
+            route->handler(pcb, &req);
+        break;
+    case ROUTE_METHOD_NOT_ALLOWED:
+        send_empty_status(pcb, "405 Method Not Allowed");
+        break;
+    default:
+        send_empty_status(pcb, "404 Not Found");
+        break;
+    }
+    http_count(route, t0);
+    json_arena_reset(); // whatever the handler parsed is gone
+
+    if (c->state == CONN_SENDING)
+        return ERR_OK;
+    return conn_close(c);
+}
+
+// True once the header block and Content-Length bytes of body are in the buffer.
+static bool http_request_complete(const http_conn_t *c)
+{
+    const char *blank = strstr(c->buf, "\r\n\r\n");
+    if (!blank)
+        return false;
+
+    http_request_t req;
+    if (!http_parse_request(c->buf, c->len, &req))
+        return true; // malformed, let http_dispatch() answer 400
+    return req.content_length <= 0 || req.body_len >= req.content_length;
+}
+
+static err_t http_handler(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    http_conn_t *c = (http_conn_t *)arg;
+
+    if (!p)
+    {
+        // Client sent FIN
+        if (!c)
         {
-            printf("Missing text field\n");
-            cJSON_Delete(json);
-            send_empty_200(pcb);
             tcp_close(pcb);
             return ERR_OK;
         }
+        return conn_close(c);
+    }
 
-        /* 3. Build POST body for ESP32 */
-        char esp_body[128];
-        snprintf(esp_body, sizeof(esp_body),
-                 "{\"text\":\"%s\"}", txt->valuestring);
-
-        cJSON_Delete(json);
-
-        /* 4. Build HTTP request to ESP32 */
-        char esp_req[256];
-        snprintf(esp_req, sizeof(esp_req),
-                 "POST /api/text HTTP/1.1\r\n"
-                 "Host: %s\r\n"
-                 "Content-Type: application/json\r\n"
-                 "Content-Length: %d\r\n"
-                 "Connection: close\r\n"
-                 "\r\n"
-                 "%s",
-                 ESP32_IP,
-                 strlen(esp_body),
-                 esp_body);
-
-        /* 5. Send to ESP32 */
-        esp32_send_http(esp_req); // ← your existing TCP send function
-
-        /* 6. Reply to original client */
-        send_empty_200(pcb);
-        tcp_close(pcb);
+    if (err != ERR_OK || !c || c->state != CONN_RECEIVING)
+    {
+        // Response already on its way; anything else the client sends is ignored.
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
         return ERR_OK;
     }
+
+    uint16_t room = HTTP_REQ_BUF_LEN - 1 - c->len;
+    uint16_t take = (p->tot_len < room) ? p->tot_len : room;
+    bool overflow = p->tot_len > room;
+
+    pbuf_copy_partial(p, c->buf + c->len, take, 0);
+    c->len += take;
+    c->buf[c->len] = '\0';
+    c->last_ms = sys_now();
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    if (overflow)
+    {
+        send_empty_status(pcb, "413 Payload Too Large");
+        return conn_close(c);
+    }
+
+    if (!http_request_complete(c))
+        return ERR_OK; // wait for the rest; conn_poll() reaps it if it never comes
+
+    return http_dispatch(c);
 }
 
 /* ===================== ACCEPT CALLBACK ===================== */
@@ -220,8 +807,35 @@ static err_t http_handler(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t
 static err_t accept_callback(void *arg, struct tcp_pcb *client, err_t err)
 {
     (void)arg;
-    (void)err;
+
+    if (err != ERR_OK || !client)
+        return ERR_VAL;
+
+    http_conn_t *c = conn_alloc(client);
+    if (!c && conn_evict_one())
+        c = conn_alloc(client);
+
+    if (!c)
+    {
+        // Everybody is mid-response. Tell this one to come back rather than leaving it hanging.
+        http_conn_refused++;
+        tcp_arg(client, NULL);
+        send_empty_status(client, "503 Service Unavailable");
+        if (tcp_close(client) != ERR_OK)
+        {
+            tcp_abort(client);
+            return ERR_ABRT;
+        }
+        return ERR_OK;
+    }
+
+    http_conn_accepted++;
+    tcp_setprio(client, TCP_PRIO_NORMAL);
+    tcp_arg(client, c);
     tcp_recv(client, http_handler);
+    tcp_sent(client, conn_sent);
+    tcp_poll(client, conn_poll, HTTP_POLL_INTERVAL);
+    tcp_err(client, conn_err);
     return ERR_OK;
 }
 
@@ -0,0 +1,70 @@
+#ifndef JSON_ARENA_HELPER_H
+#define JSON_ARENA_HELPER_H
+
+// This is json_arena_helper.h, where cJSON gets its memory from on the master.
+// cJSON allocates every node and every string separately through its hooks, by default from the C heap.
+// lwIP is not affected (with threadsafe_background, MEM_LIBC_MALLOC is 0 and it has its own MEM_SIZE
+// heap), but the C heap lives as long as the firmware, and a few dozen small blocks per POST, freed
+// again a moment later, is how a long-running heap ends up in pieces. So cJSON_InitHooks() points cJSON
+// at a bump allocator over one static buffer instead: allocating is a pointer increment, free does
+// nothing, and http_dispatch() rewinds the whole arena once the handler has returned. The arena keeps
+// the C heap unfragmented; parsing never touches it.
+//
+// A request's tree must not outlive its handler, which the handlers already guarantee by copying what
+// they keep (and calling cJSON_Delete, which is harmless here). Only Core1 parses JSON, so no locking.
+// A body the arena cannot hold fails to parse and gets the route's 400, same as bad JSON.
+
+#include "cJSON.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// /api/control's max_body. It is the only route that still builds a tree; the others read their one
+// member with the streaming parser, which allocates nothing. The worst body, "[0,0,...]", is a node per
+// two bytes; strings take at least three bytes each ("",) and are copied out once, rounded up to 8.
+// About 1.6 KB with the RP2350's 40-byte nodes, more on a 64-bit host.
+#define JSON_ARENA_BODY_MAX 64
+#define JSON_ARENA_SIZE ((JSON_ARENA_BODY_MAX / 2 + 1) * sizeof(cJSON) + 4 * JSON_ARENA_BODY_MAX)
+#define JSON_ARENA_ALIGN 8 // cJSON nodes hold a double
+
+static uint8_t json_arena[JSON_ARENA_SIZE] __attribute__((aligned(JSON_ARENA_ALIGN)));
+static size_t json_arena_used = 0;
+
+// For /metrics
+static size_t json_arena_high = 0;
+static uint32_t json_arena_overflows = 0;
+
+static void *CJSON_CDECL json_arena_malloc(size_t size)
+{
+    size = (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+    if (size > JSON_ARENA_SIZE - json_arena_used)
+    {
+        json_arena_overflows++;
+        return NULL; // cJSON cleans up and the parse returns NULL
+    }
+
+    void *p = json_arena + json_arena_used;
+    json_arena_used += size;
+    if (json_arena_used > json_arena_high)
+        json_arena_high = json_arena_used;
+    return p;
+}
+
+static void CJSON_CDECL json_arena_free(void *p)
+{
+    (void)p; // everything goes at once in json_arena_reset()
+}
+
+// Once at boot, before the first request.
+static void json_arena_init(void)
+{
+    cJSON_Hooks hooks = {.malloc_fn = json_arena_malloc, .free_fn = json_arena_free};
+    cJSON_InitHooks(&hooks);
+}
+
+// End of request: every cJSON pointer handed out since the last reset is gone.
+static inline void json_arena_reset(void)
+{
+    json_arena_used = 0;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef LINK_CODEC_HELPER_H
+#define LINK_CODEC_HELPER_H
+
+// This is link_codec_helper.h, the framing for the wired UART link between the master and the ESP32.
+// The link used to carry "CMD=72 22\n" and "TXT=...\n" lines: no way to tell a corrupted line from a
+// good one, no way to notice a lost one, and a text containing '\n' broke the framing. Now every
+// message is a binary frame:
+//
+//   payload   u8 type | u8 seq | data (0..LINK_MAX_DATA bytes) | u16 CRC-16/CCITT-FALSE, little-endian
+//   wire      COBS(payload) 0x00
+//
+// COBS removes every zero byte from the payload, so 0x00 only ever appears as the frame delimiter. A
+// receiver that starts listening mid-stream, or loses bytes, resynchronises at the next zero. The CRC
+// covers type, seq and data. seq counts up per sender, so a gap shows a lost frame.
+//
+// This file is plain C with no Pico dependencies: the firmware (uart_link_helper.h) and the host
+// decoder (linkdecode/) both use it. The ESP32 carries its own copy of the same format.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define LINK_MAX_DATA 64
+#define LINK_PAYLOAD_MAX (2 + LINK_MAX_DATA + 2)
+#define LINK_FRAME_MAX (LINK_PAYLOAD_MAX + LINK_PAYLOAD_MAX / 254 + 2) // COBS overhead + delimiter
+
+// Message types. 0x0_ link management, 0x1_ master -> ESP32, 0x2_ ESP32 -> master.
+#define LINK_MSG_HELLO 0x01     // u32 baud: the sender can run the link this fast
+#define LINK_MSG_HELLO_ACK 0x02 // u32 baud: agreed, switching now
+#define LINK_MSG_KEEPALIVE 0x03 // no data: the master is still there, sent when it has been quiet
+#define LINK_MSG_TELEMETRY 0x10 // the 20-byte status record from telemetry_helper.h
+#define LINK_MSG_TEXT 0x11      // text for the display, not NUL-terminated
+#define LINK_MSG_LOG 0x20       // text for the master's console
+#define LINK_MSG_STATS 0x21     // u32 frames, u32 crc errors, u32 lost: what the ESP32 received, every 1 s
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t data[LINK_MAX_DATA];
+} link_msg_t;
+
+// Byte-at-a-time receiver. Keeps the COBS-encoded bytes of the current frame until the delimiter.
+typedef struct
+{
+    uint8_t buf[LINK_FRAME_MAX];
+    uint16_t len;
+    bool overflow;
+    bool synced;   // seen a delimiter, so buf starts at a frame boundary
+    bool have_seq;
+    uint8_t last_seq;
+
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t framing_errors; // bad COBS, too long or too short
+    uint32_t lost;           // frames missing according to seq
+} link_rx_t;
+
+typedef enum
+{
+    LINK_RX_NONE = 0,
+    LINK_RX_FRAME,
+    LINK_RX_BAD,
+} link_rx_result_t;
+
+static inline uint16_t link_crc16(const uint8_t *p, size_t n, uint16_t crc)
+{
+    while (n--)
+    {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Returns the encoded length (at most n + n / 254 + 1). No delimiter.
+static size_t link_cobs_encode(const uint8_t *in, size_t n, uint8_t *out)
+{
+    size_t code_at = 0, o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (in[i])
+        {
+            out[o++] = in[i];
+            code++;
+        }
+        if (!in[i] || code == 0xFF)
+        {
+            out[code_at] = code;
+            code = 1;
+            code_at = o++;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+// Returns the decoded length, or -1 if in is not valid COBS. out may not alias in.
+static int link_cobs_decode(const uint8_t *in, size_t n, uint8_t *out)
+{
+    size_t i = 0, o = 0;
+
+    while (i < n)
+    {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > n)
+            return -1;
+        for (uint8_t k = 1; k < code; k++)
+        {
+            if (!in[i])
+                return -1;
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < n)
+            out[o++] = 0;
+    }
+    return (int)o;
+}
+
+// Builds a complete wire frame, delimiter included, into out (LINK_FRAME_MAX bytes). Returns its
+// length, or 0 if n is over LINK_MAX_DATA.
+static size_t link_frame_encode(uint8_t type, uint8_t seq, const void *data, size_t n, uint8_t *out)
+{
+    uint8_t payload[LINK_PAYLOAD_MAX];
+
+    if (n > LINK_MAX_DATA)
+        return 0;
+    payload[0] = type;
+    payload[1] = seq;
+    if (n)
+        memcpy(payload + 2, data, n);
+    uint16_t crc = link_crc16(payload, n + 2, 0xFFFF);
+    payload[n + 2] = (uint8_t)crc;
+    payload[n + 3] = (uint8_t)(crc >> 8);
+
+    size_t len = link_cobs_encode(payload, n + 4, out);
+    out[len++] = 0;
+    return len;
+}
+
+// Feeds one received byte. LINK_RX_FRAME means *msg holds a frame that passed its CRC; LINK_RX_BAD
+// means a frame was dropped (counted in rx). Bytes before the first delimiter are skipped.
+static link_rx_result_t link_rx_byte(link_rx_t *rx, uint8_t b, link_msg_t *msg)
+{
+    if (b != 0)
+    {
+        if (rx->len < sizeof(rx->buf))
+            rx->buf[rx->len++] = b;
+        else
+            rx->overflow = true;
+        return LINK_RX_NONE;
+    }
+
+    // Delimiter: decode what came before it.
+    uint16_t len = rx->len;
+    bool overflow = rx->overflow, synced = rx->synced;
+    rx->len = 0;
+    rx->overflow = false;
+    rx->synced = true;
+    if (!synced || len == 0)
+        return LINK_RX_NONE; // partial frame from before we started listening, or back-to-back zeros
+
+    uint8_t payload[LINK_FRAME_MAX];
+    int n = overflow ? -1 : link_cobs_decode(rx->buf, len, payload);
+    if (n < 4 || n > LINK_PAYLOAD_MAX)
+    {
+        rx->framing_errors++;
+        return LINK_RX_BAD;
+    }
+    uint16_t crc = (uint16_t)(payload[n - 2] | (payload[n - 1] << 8));
+    if (link_crc16(payload, (size_t)n - 2, 0xFFFF) != crc)
+    {
+        rx->crc_errors++;
+        return LINK_RX_BAD;
+    }
+
+    msg->type = payload[0];
+    msg->seq = payload[1];
+    msg->len = (uint8_t)(n - 4);
+    memcpy(msg->data, payload + 2, msg->len);
+
+    if (rx->have_seq)
+        rx->lost += (uint8_t)(msg->seq - rx->last_seq - 1);
+    rx->have_seq = true;
+    rx->last_seq = msg->seq;
+    rx->frames++;
+    return LINK_RX_FRAME;
+}
+
+static inline uint32_t link_get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#endif
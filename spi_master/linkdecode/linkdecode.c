@@ -0,0 +1,153 @@
+// linkdecode.c - host-side decoder for the master -> ESP32 UART link.
+//
+// Reads the raw byte stream of the link (a capture file, a USB-serial adapter clipped onto the wire, or
+// stdin) and prints every frame with link_codec_helper.h, the same decoder the firmware uses. At the
+// end it prints the counters: frames, CRC errors, framing errors and frames lost according to seq.
+//
+// -g generates a stream instead, so the codec can be checked without hardware:
+//
+//   ./build/linkdecode -g 10000 -e 1000 | ./build/linkdecode -q
+//
+// Usage: linkdecode [-q] [file]         decode (stdin if no file)
+//        linkdecode -g count [-e n]     write count frames to stdout, corrupting one byte in n
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "link_codec_helper.h"
+#include "telemetry_helper.h"
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void print_msg(const link_msg_t *m)
+{
+    printf("seq %3u  ", m->seq);
+    switch (m->type)
+    {
+    case LINK_MSG_HELLO:
+    case LINK_MSG_HELLO_ACK:
+        printf("%-9s baud %lu\n", m->type == LINK_MSG_HELLO ? "HELLO" : "HELLO_ACK",
+               m->len >= 4 ? (unsigned long)link_get_le32(m->data) : 0ul);
+        break;
+    case LINK_MSG_KEEPALIVE:
+        printf("KEEPALIVE\n");
+        break;
+    case LINK_MSG_TELEMETRY:
+        if (m->len < TELEMETRY_STATUS_LEN)
+        {
+            printf("TELEMETRY short (%u bytes)\n", m->len);
+            break;
+        }
+        printf("TELEMETRY temp %u led %u raw %lu time %lu seq %lu applied %u\n", get_le16(m->data + 2),
+               m->data[1], (unsigned long)link_get_le32(m->data + 4), (unsigned long)link_get_le32(m->data + 8),
+               (unsigned long)link_get_le32(m->data + 12), get_le16(m->data + 16));
+        break;
+    case LINK_MSG_TEXT:
+    case LINK_MSG_LOG:
+        printf("%-9s \"%.*s\"\n", m->type == LINK_MSG_TEXT ? "TEXT" : "LOG", m->len, (const char *)m->data);
+        break;
+    case LINK_MSG_STATS:
+        printf("STATS     frames %lu crc %lu lost %lu\n", m->len >= 12 ? (unsigned long)link_get_le32(m->data) : 0ul,
+               m->len >= 12 ? (unsigned long)link_get_le32(m->data + 4) : 0ul,
+               m->len >= 12 ? (unsigned long)link_get_le32(m->data + 8) : 0ul);
+        break;
+    default:
+        printf("type 0x%02x, %u bytes\n", m->type, m->len);
+        break;
+    }
+}
+
+static int decode(FILE *in, int quiet)
+{
+    link_rx_t rx;
+    link_msg_t msg;
+    int c;
+
+    memset(&rx, 0, sizeof(rx));
+    rx.synced = 1; // a capture normally starts at a frame; a partial first frame is counted as an error
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (link_rx_byte(&rx, (uint8_t)c, &msg) == LINK_RX_FRAME && !quiet)
+            print_msg(&msg);
+    }
+
+    printf("frames %lu, crc errors %lu, framing errors %lu, lost %lu\n", (unsigned long)rx.frames,
+           (unsigned long)rx.crc_errors, (unsigned long)rx.framing_errors, (unsigned long)rx.lost);
+    return (rx.crc_errors || rx.framing_errors) ? 1 : 0;
+}
+
+// Mix of telemetry and text, the way Core0 sends them.
+static int generate(unsigned long count, unsigned long corrupt_every)
+{
+    uint8_t frame[LINK_FRAME_MAX];
+    unsigned long bytes = 0;
+
+    srand(1);
+    for (unsigned long i = 0; i < count; i++)
+    {
+        uint8_t data[LINK_MAX_DATA];
+        size_t len;
+
+        if (i % 10 == 9)
+        {
+            len = (size_t)snprintf((char *)data, sizeof(data), "message %lu", i);
+            len = link_frame_encode(LINK_MSG_TEXT, (uint8_t)i, data, len, frame);
+        }
+        else
+        {
+            telemetry_status_encode(data, (uint32_t)rand() & 0xFFFFF, (uint16_t)(60 + i % 30), (uint8_t)(i & 0x0F),
+                                    (uint32_t)i, (uint32_t)i, (uint16_t)(i / 7));
+            len = link_frame_encode(LINK_MSG_TELEMETRY, (uint8_t)i, data, TELEMETRY_STATUS_LEN, frame);
+        }
+
+        for (size_t k = 0; k < len; k++, bytes++)
+        {
+            if (corrupt_every && (unsigned long)rand() % corrupt_every == 0)
+                frame[k] ^= (uint8_t)(1 + rand() % 255);
+        }
+        fwrite(frame, 1, len, stdout);
+    }
+    fprintf(stderr, "%lu frames, %lu bytes\n", count, bytes);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long gen = 0, corrupt = 0;
+    int quiet = 0, opt;
+
+    while ((opt = getopt(argc, argv, "g:e:qh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            gen = strtoul(optarg, NULL, 10);
+            break;
+        case 'e':
+            corrupt = strtoul(optarg, NULL, 10);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-q] [file] | -g count [-e n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (gen)
+        return generate(gen, corrupt);
+
+    FILE *in = stdin;
+    if (optind < argc && !(in = fopen(argv[optind], "rb")))
+    {
+        perror(argv[optind]);
+        return 2;
+    }
+    return decode(in, quiet);
+}
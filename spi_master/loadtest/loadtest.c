@@ -0,0 +1,634 @@
+// loadtest.c - host-side load test for the spi_master HTTP server.
+//
+// Builds http_helper.h exactly as the firmware uses it, against lwIP on Linux, and serves it on lwIP's
+// loopback netif (127.0.0.1:80). A load generator living in the same lwIP stack opens N concurrent
+// client connections and drives GET /api/status, POST /api/control and POST /api/text in a configurable
+// mix. A stand-in ESP32 on 127.0.0.1:8080 answers the forwarded text over
+// the server's keep-alive client connection. Core0 is simulated by
+// republishing the status snapshot on a timer.
+//
+// Everything runs in one thread, one lwIP, no pcap or tap device, so numbers are reproducible run to
+// run on the same machine. Absolute figures are host figures; compare them between server changes,
+// not against the Pico.
+//
+// After the run it scrapes GET /metrics once and checks that the exposition parses.
+//
+// Usage: loadtest [-c concurrency] [-n requests] [-m status,control,text] [-p publish_ms] [-s seed] [-b] [-M]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/timeouts.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "lwip/tcp.h"
+
+#include "http_helper.h"
+
+/* ===================== HOST GLUE ===================== */
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)now_us();
+}
+
+u32_t sys_now(void)
+{
+    return (u32_t)(now_us() / 1000);
+}
+
+/* ===================== REQUESTS ===================== */
+
+enum
+{
+    KIND_STATUS = 0,
+    KIND_CONTROL,
+    KIND_TEXT,
+    KIND_COUNT
+};
+
+static const char *const kind_names[KIND_COUNT] = {"status", "control", "text"};
+
+// Sent straight from ROM (no TCP_WRITE_FLAG_COPY), so the clients never allocate from the lwIP heap
+// and the heap high-water mark is the server's.
+static const char req_status[] =
+    "GET /api/status HTTP/1.1\r\n"
+    "Host: pico\r\n\r\n";
+static const char req_status_bin[] =
+    "GET /api/status HTTP/1.1\r\n"
+    "Host: pico\r\n"
+    "Accept: application/octet-stream\r\n\r\n";
+static const char req_control[] =
+    "POST /api/control HTTP/1.1\r\n"
+    "Host: pico\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 9\r\n\r\n"
+    "{\"led\":2}";
+static const char req_text[] =
+    "POST /api/text HTTP/1.1\r\n"
+    "Host: pico\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 16\r\n\r\n"
+    "{\"text\":\"hello\"}";
+
+static const char *kind_reqs[KIND_COUNT] = {req_status, req_control, req_text};
+static u16_t kind_lens[KIND_COUNT] = {sizeof(req_status) - 1, sizeof(req_control) - 1,
+                                      sizeof(req_text) - 1};
+
+/* ===================== RESULTS ===================== */
+
+typedef struct
+{
+    uint32_t *lat_us; // one entry per completed request
+    uint32_t done;
+    uint32_t by_kind[KIND_COUNT];
+    uint32_t by_class[6]; // 1xx..5xx, [0] = no status line
+    uint32_t errors;      // connect failures, resets, aborts
+} results_t;
+
+static results_t results;
+
+/* ===================== CLIENTS ===================== */
+
+typedef struct
+{
+    struct tcp_pcb *pcb;
+    int kind;
+    uint64_t t0;
+    char head[16]; // enough for "HTTP/1.1 200"
+    u16_t head_len;
+    bool busy;
+} client_t;
+
+static client_t clients[LOADTEST_MAX_CONCURRENCY];
+static int concurrency = 4;
+static uint32_t target = 2000;
+static uint32_t started = 0;
+static int mix[KIND_COUNT] = {80, 15, 5};
+static ip_addr_t server_ip;
+
+static int pick_kind(void)
+{
+    int r = rand() % (mix[0] + mix[1] + mix[2]);
+    if (r < mix[0])
+        return KIND_STATUS;
+    return (r < mix[0] + mix[1]) ? KIND_CONTROL : KIND_TEXT;
+}
+
+static void client_finish(client_t *cl, bool ok)
+{
+    if (ok)
+    {
+        int cls = 0;
+        if (cl->head_len >= 12 && memcmp(cl->head, "HTTP/1.", 7) == 0)
+            cls = cl->head[9] - '0';
+        if (cls < 1 || cls > 5)
+            cls = 0;
+        results.by_class[cls]++;
+        results.by_kind[cl->kind]++;
+        results.lat_us[results.done++] = (uint32_t)(now_us() - cl->t0);
+    }
+    else
+    {
+        results.errors++;
+    }
+    cl->busy = false;
+    cl->pcb = NULL;
+}
+
+static err_t client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    client_t *cl = (client_t *)arg;
+    (void)err;
+
+    if (!p)
+    {
+        // Server closed: the response is complete.
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_err(pcb, NULL);
+        if (tcp_close(pcb) != ERR_OK)
+        {
+            tcp_abort(pcb);
+            client_finish(cl, true);
+            return ERR_ABRT;
+        }
+        client_finish(cl, true);
+        return ERR_OK;
+    }
+
+    if (cl->head_len < sizeof(cl->head))
+    {
+        cl->head_len += pbuf_copy_partial(p, cl->head + cl->head_len,
+                                          sizeof(cl->head) - cl->head_len, 0);
+    }
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static void client_err(void *arg, err_t err)
+{
+    (void)err;
+    client_t *cl = (client_t *)arg;
+    if (cl)
+        client_finish(cl, false);
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    client_t *cl = (client_t *)arg;
+    (void)err;
+
+    if (tcp_write(pcb, kind_reqs[cl->kind], kind_lens[cl->kind], 0) != ERR_OK)
+    {
+        tcp_arg(pcb, NULL);
+        tcp_abort(pcb);
+        client_finish(cl, false);
+        return ERR_ABRT;
+    }
+    tcp_output(pcb);
+    return ERR_OK;
+}
+
+static void client_start(client_t *cl)
+{
+    struct tcp_pcb *pcb = tcp_new();
+    if (!pcb)
+    {
+        results.errors++;
+        started++;
+        return;
+    }
+
+    cl->pcb = pcb;
+    cl->kind = pick_kind();
+    cl->head_len = 0;
+    cl->busy = true;
+    cl->t0 = now_us();
+    started++;
+
+    tcp_arg(pcb, cl);
+    tcp_recv(pcb, client_recv);
+    tcp_err(pcb, client_err);
+    if (tcp_connect(pcb, &server_ip, 80, client_connected) != ERR_OK)
+    {
+        tcp_arg(pcb, NULL);
+        tcp_abort(pcb);
+        client_finish(cl, false);
+    }
+}
+
+/* ===================== ESP32 STAND-IN ===================== */
+
+// Answers every request on a connection with the same small 200, like the ESP32's httpd does, and
+// keeps the connection open. A request ends at its blank line; the bodies are short JSON that never
+// contains one, so counting "\r\n\r\n" is enough here. arg holds how much of it has been matched.
+static const char esp_sink_reply[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 11\r\n"
+    "\r\n"
+    "{\"ok\":true}";
+
+static uint32_t esp_sink_requests = 0;
+
+static err_t esp_sink_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    (void)err;
+    if (!p)
+    {
+        if (tcp_close(pcb) != ERR_OK)
+        {
+            tcp_abort(pcb);
+            return ERR_ABRT;
+        }
+        return ERR_OK;
+    }
+
+    uintptr_t matched = (uintptr_t)arg;
+    for (u16_t i = 0; i < p->tot_len; i++)
+    {
+        char ch = (char)pbuf_get_at(p, i);
+        matched = (ch == "\r\n\r\n"[matched]) ? matched + 1 : (ch == '\r');
+        if (matched == 4)
+        {
+            matched = 0;
+            esp_sink_requests++;
+            tcp_write(pcb, esp_sink_reply, sizeof(esp_sink_reply) - 1, 0);
+        }
+    }
+    tcp_arg(pcb, (void *)matched);
+    tcp_output(pcb);
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static err_t esp_sink_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    (void)arg;
+    (void)err;
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, esp_sink_recv);
+    return ERR_OK;
+}
+
+static struct tcp_pcb *listen_on(u16_t port, tcp_accept_fn fn, u8_t backlog)
+{
+    struct tcp_pcb *pcb = tcp_new();
+    if (!pcb || tcp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK)
+    {
+        fprintf(stderr, "bind %u failed\n", port);
+        exit(1);
+    }
+    pcb = tcp_listen_with_backlog(pcb, backlog);
+    tcp_accept(pcb, fn);
+    return pcb;
+}
+
+/* ===================== SCRAPER ===================== */
+
+// Fetches /metrics once, the way a Prometheus server would, and checks that every line of the body
+// is a HELP/TYPE comment or a "name{labels} value" sample.
+#define SCRAPE_MAX 32768
+
+static const char req_metrics[] =
+    "GET /metrics HTTP/1.1\r\n"
+    "Host: pico\r\n\r\n";
+
+static struct
+{
+    char *buf;
+    size_t len;
+    bool done;
+    bool failed;
+} scrape;
+
+static err_t scrape_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    (void)arg;
+    (void)err;
+
+    if (!p)
+    {
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_err(pcb, NULL);
+        scrape.done = true;
+        if (tcp_close(pcb) != ERR_OK)
+        {
+            tcp_abort(pcb);
+            return ERR_ABRT;
+        }
+        return ERR_OK;
+    }
+
+    if (scrape.len + p->tot_len < SCRAPE_MAX)
+        scrape.len += pbuf_copy_partial(p, scrape.buf + scrape.len, p->tot_len, 0);
+    else
+        scrape.failed = true;
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static void scrape_err(void *arg, err_t err)
+{
+    (void)arg;
+    (void)err;
+    scrape.failed = scrape.done = true;
+}
+
+static err_t scrape_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    (void)arg;
+    (void)err;
+    tcp_write(pcb, req_metrics, sizeof(req_metrics) - 1, 0);
+    tcp_output(pcb);
+    return ERR_OK;
+}
+
+static bool metric_line_ok(const char *line, const char *end)
+{
+    if (*line == '#')
+        return (end - line > 7) && (strncmp(line, "# HELP ", 7) == 0 || strncmp(line, "# TYPE ", 7) == 0);
+
+    const char *p = line;
+    if (!(*p == '_' || *p == ':' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+        return false;
+    while (p < end && (*p == '_' || *p == ':' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                       (*p >= '0' && *p <= '9')))
+        p++;
+    if (p < end && *p == '{')
+    {
+        p = memchr(p, '}', end - p);
+        if (!p)
+            return false;
+        p++;
+    }
+    if (p >= end || *p != ' ')
+        return false;
+
+    char num[32];
+    size_t n = (size_t)(end - p - 1);
+    if (n == 0 || n >= sizeof(num))
+        return false;
+    memcpy(num, p + 1, n);
+    num[n] = '\0';
+    char *stop;
+    strtod(num, &stop);
+    return *stop == '\0' || strcmp(num, "+Inf") == 0;
+}
+
+// Returns the number of problems found (0 = good scrape). dump prints the body.
+static int scrape_metrics(bool dump)
+{
+    scrape.buf = malloc(SCRAPE_MAX);
+    scrape.len = 0;
+    scrape.done = scrape.failed = false;
+
+    struct tcp_pcb *pcb = tcp_new();
+    if (!scrape.buf || !pcb)
+        return 1;
+    tcp_recv(pcb, scrape_recv);
+    tcp_err(pcb, scrape_err);
+    if (tcp_connect(pcb, &server_ip, 80, scrape_connected) != ERR_OK)
+        return 1;
+
+    uint64_t deadline = now_us() + 2000000;
+    while (!scrape.done && now_us() < deadline)
+    {
+        netif_poll_all();
+        sys_check_timeouts();
+    }
+
+    int problems = (!scrape.done || scrape.failed) ? 1 : 0;
+    uint32_t samples = 0;
+    scrape.buf[scrape.len] = '\0';
+
+    char *body = strstr(scrape.buf, "\r\n\r\n");
+    if (strncmp(scrape.buf, "HTTP/1.1 200", 12) != 0 || !body)
+        problems++;
+    else
+    {
+        body += 4;
+        for (char *line = body; *line;)
+        {
+            char *eol = strchr(line, '\n');
+            if (!eol)
+            {
+                problems++; // last line must end with a newline
+                break;
+            }
+            if (!metric_line_ok(line, eol))
+            {
+                fprintf(stderr, "bad metrics line: %.*s\n", (int)(eol - line), line);
+                problems++;
+            }
+            else if (*line != '#')
+                samples++;
+            line = eol + 1;
+        }
+        if (dump)
+            fputs(body, stdout);
+    }
+
+    printf("metrics       %u samples in %zu bytes, %s\n", samples, scrape.len, problems ? "FAILED" : "ok");
+    free(scrape.buf);
+    return problems;
+}
+
+/* ===================== REPORT ===================== */
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, uint32_t n, double p)
+{
+    if (n == 0)
+        return 0;
+    uint32_t i = (uint32_t)(p * n);
+    return sorted[i >= n ? n - 1 : i];
+}
+
+static void report(uint64_t elapsed_us)
+{
+    qsort(results.lat_us, results.done, sizeof(uint32_t), cmp_u32);
+
+    printf("requests      %u ok, %u errors, concurrency %d\n", results.done, results.errors, concurrency);
+    printf("mix          ");
+    for (int k = 0; k < KIND_COUNT; k++)
+        printf(" %s %u%s", kind_names[k], results.by_kind[k], k + 1 < KIND_COUNT ? "," : "\n");
+    printf("responses     2xx %u, 4xx %u, 5xx %u, no status %u\n",
+           results.by_class[2], results.by_class[4], results.by_class[5], results.by_class[0]);
+    printf("throughput    %.1f req/s over %.3f s\n",
+           elapsed_us ? results.done * 1e6 / elapsed_us : 0.0, elapsed_us / 1e6);
+    printf("latency (us)  p50 %u  p99 %u  p999 %u  max %u\n",
+           percentile(results.lat_us, results.done, 0.50),
+           percentile(results.lat_us, results.done, 0.99),
+           percentile(results.lat_us, results.done, 0.999),
+           results.done ? results.lat_us[results.done - 1] : 0);
+
+    printf("lwIP heap     max %u of %u bytes, %u alloc failures\n",
+           (unsigned)lwip_stats.mem.max, (unsigned)MEM_SIZE, (unsigned)lwip_stats.mem.err);
+    for (int i = 0; i < MEMP_MAX; i++)
+    {
+        const struct stats_mem *m = lwip_stats.memp[i];
+        if (m && m->max)
+            printf("  memp %-14s max %u of %u, %u failures\n", m->name, (unsigned)m->max,
+                   (unsigned)m->avail, (unsigned)m->err);
+    }
+    printf("command queue enqueued %lu, dropped %lu, max depth %lu, batches %lu, latency max %lu us\n",
+           (unsigned long)cmdq_enqueued, (unsigned long)cmdq_dropped, (unsigned long)cmdq_max_depth,
+           (unsigned long)cmdq_batches, (unsigned long)cmdq_lat_max_us);
+    printf("esp32 client  connects %lu, responses %lu, reused %lu, failures %lu, refused %lu (stand-in saw %lu)\n",
+           (unsigned long)espc_connects, (unsigned long)espc_requests, (unsigned long)espc_reused,
+           (unsigned long)espc_failures, (unsigned long)espc_refused, (unsigned long)esp_sink_requests);
+    printf("server conns  accepted %lu, refused %lu, evicted %lu, reaped %lu, errors %lu\n",
+           (unsigned long)http_conn_accepted, (unsigned long)http_conn_refused,
+           (unsigned long)http_conn_evicted, (unsigned long)http_conn_reaped,
+           (unsigned long)http_conn_errors);
+}
+
+/* ===================== MAIN ===================== */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-c concurrency (1-%d)] [-n requests] [-m status,control,text] "
+            "[-p publish_ms] [-s seed] [-b] [-M]\n",
+            argv0, LOADTEST_MAX_CONCURRENCY);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t publish_ms = 10; // how often "Core0" republishes the status snapshot
+    unsigned seed = 1;
+    bool dump_metrics = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:m:p:s:bMh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            concurrency = atoi(optarg);
+            break;
+        case 'n':
+            target = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            if (sscanf(optarg, "%d,%d,%d", &mix[0], &mix[1], &mix[2]) != 3)
+                usage(argv[0]);
+            break;
+        case 'p':
+            publish_ms = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'M':
+            dump_metrics = true;
+            break;
+        case 'b': // status polls ask for the packed binary record
+            kind_reqs[KIND_STATUS] = req_status_bin;
+            kind_lens[KIND_STATUS] = sizeof(req_status_bin) - 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (concurrency < 1 || concurrency > LOADTEST_MAX_CONCURRENCY || target == 0 ||
+        mix[0] < 0 || mix[1] < 0 || mix[2] < 0 || mix[0] + mix[1] + mix[2] == 0)
+        usage(argv[0]);
+
+    srand(seed);
+    results.lat_us = calloc(target, sizeof(uint32_t));
+    if (!results.lat_us)
+        return 1;
+
+    lwip_init();
+    ipaddr_aton("127.0.0.1", &server_ip);
+
+    // Same bring-up as core1_main(), minus the Wi-Fi.
+    if (!http_routes_init())
+    {
+        fprintf(stderr, "route table overflow\n");
+        return 1;
+    }
+    listen_on(80, accept_callback, HTTP_POOL_CONNS);
+    listen_on(ESP32_PORT, esp_sink_accept, 4);
+
+    uint32_t sample = 0;
+    status_snapshot_publish(0, 0, 0, 0);
+    cmdq_init();
+    uint64_t next_publish = now_us();
+
+    uint64_t t_start = now_us();
+    uint32_t finished = 0;
+
+    while (finished < target)
+    {
+        uint64_t t = now_us();
+        if (t >= next_publish)
+        {
+            // Fake but plausible slave data, changing every publish. "Core0" drains the command
+            // queue and the fake slave confirms any LED command on the spot.
+            sample++;
+            cmd_t cmd;
+            int n = 0;
+            while (n < CMDQ_BATCH && cmdq_pop(&cmd))
+            {
+                n++;
+                if (cmd.type == CMD_LED_SET)
+                    ctl_merge(cmd.led.id, cmd.led.mask, cmd.led.value);
+            }
+            if (n)
+                cmdq_batches++;
+            metrics_core0.spi_transactions++;
+            metrics_core0.loops++;
+            if (ctl_pending())
+            {
+                uint8_t frame[3];
+                ctl_next_frame(frame);
+                ctl_on_reply(frame[0]);
+            }
+            status_snapshot_publish(2300 + sample % 100, 60 + sample % 10, sample & 0x0F, ctl_applied);
+            history_push(sys_now(), 2300 + sample % 100, 60 + sample % 10, sample & 0x0F);
+            next_publish = t + publish_ms * 1000;
+        }
+
+        for (int i = 0; i < concurrency; i++)
+        {
+            if (!clients[i].busy && started < target)
+                client_start(&clients[i]);
+        }
+
+        netif_poll_all();
+        sys_check_timeouts();
+
+        finished = results.done + results.errors;
+    }
+
+    report(now_us() - t_start);
+    int bad_scrape = scrape_metrics(dump_metrics);
+    free(results.lat_us);
+    return (results.errors || bad_scrape) ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#ifndef LOADTEST_LWIPOPTS_H
+#define LOADTEST_LWIPOPTS_H
+
+// lwIP options for the host load test. Starts from the firmware's lwipopts.h so the server runs with
+// the same heap, windows and pools it has on the Pico 2W, then turns on the loopback netif and the
+// statistics the report needs. PICO_CYW43_ARCH_POLL is not defined here, so MEM_LIBC_MALLOC is 0 and
+// the MEM_SIZE heap is a real, measurable lwIP heap.
+
+#include "../lwipopts.h"
+
+#define LWIP_HAVE_LOOPIF 1
+#define LWIP_NETIF_LOOPBACK 1
+#undef LWIP_DHCP
+#define LWIP_DHCP 0
+
+// The load generator's clients live in the same stack, so give them their own PCBs and segments on
+// top of the firmware's. Their requests are sent from ROM (no copy), so they do not touch the heap.
+#define LOADTEST_MAX_CONCURRENCY 32
+#undef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB (8 + LOADTEST_MAX_CONCURRENCY)
+#undef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG (32 + 2 * LOADTEST_MAX_CONCURRENCY)
+
+#undef LWIP_STATS
+#define LWIP_STATS 1
+#undef MEM_STATS
+#define MEM_STATS 1
+#undef MEMP_STATS
+#define MEMP_STATS 1
+#undef LWIP_STATS_DISPLAY
+#define LWIP_STATS_DISPLAY 0
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef LOADTEST_SHIM_SYNC_H
+#define LOADTEST_SHIM_SYNC_H
+
+// Host stand-in for the Pico SDK's hardware/sync.h: only what the shared-memory helpers use.
+static inline void __dmb(void)
+{
+    __sync_synchronize();
+}
+
+static inline void __sev(void)
+{
+}
+
+#endif
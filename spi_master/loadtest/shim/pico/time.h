@@ -0,0 +1,24 @@
+#ifndef LOADTEST_SHIM_TIME_H
+#define LOADTEST_SHIM_TIME_H
+
+// Host stand-in for the Pico SDK's pico/time.h: just enough for the Core0 helpers to compile. The load
+// test never waits on Core0's poll interval, so every timeout has already expired.
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint64_t absolute_time_t;
+
+uint32_t time_us_32(void); // loadtest.c
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return ms;
+}
+
+static inline bool best_effort_wfe_or_timeout(absolute_time_t until)
+{
+    (void)until;
+    return true;
+}
+
+#endif
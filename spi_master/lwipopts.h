@@ -24,6 +24,9 @@
 #define MEM_SIZE                    4000
 #endif
 #define MEMP_NUM_TCP_SEG            32
+#define MEMP_NUM_TCP_PCB            8   // HTTP_POOL_CONNS + ESP32 client + TIME_WAIT slack
+#define TCP_LISTEN_BACKLOG          1
+#define MEMP_NUM_SYS_TIMEOUT        (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 1) // + ESP32 client reconnect backoff
 #define MEMP_NUM_ARP_QUEUE          10
 #define PBUF_POOL_SIZE              24
 #define LWIP_ARP                    1
@@ -38,9 +41,10 @@
 #define LWIP_NETIF_LINK_CALLBACK    1
 #define LWIP_NETIF_HOSTNAME         1
 #define LWIP_NETCONN                0
-#define MEM_STATS                   0
+#define LWIP_STATS                  1   // always on: GET /metrics reports the MEM/MEMP counters
+#define MEM_STATS                   1
 #define SYS_STATS                   0
-#define MEMP_STATS                  0
+#define MEMP_STATS                  1
 #define LINK_STATS                  0
 // #define ETH_PAD_SIZE                2
 #define LWIP_CHKSUM_ALGORITHM       3
@@ -56,7 +60,6 @@
 
 #ifndef NDEBUG
 #define LWIP_DEBUG                  1
-#define LWIP_STATS                  1
 #define LWIP_STATS_DISPLAY          1
 #endif
 
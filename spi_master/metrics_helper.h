@@ -0,0 +1,143 @@
+#ifndef METRICS_HELPER_H
+#define METRICS_HELPER_H
+
+// This is metrics_helper.h, the counters and histograms behind GET /metrics (Prometheus text format).
+// Each core has its own block and is the only one that ever writes to it, so counting is a plain
+// increment: no atomics, no locks, no shared cache lines between the cores. The scraper on Core1 reads
+// Core0's block while it changes; a sample can be one increment stale, which a monitoring system
+// never notices. All of it is cheap enough to stay on in release builds.
+//
+// Histograms use fixed buckets in microseconds, from 100 us to 1 s, so observing a value is a short
+// scan and the exposition needs no state.
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define METRICS_BUCKETS 12
+#define METRICS_MAX_ROUTES 16 // must be >= the number of entries in http_routes[]
+
+static const uint32_t metrics_bounds_us[METRICS_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+
+typedef struct
+{
+    uint32_t bucket[METRICS_BUCKETS + 1]; // last one is +Inf
+    uint32_t count;
+    uint64_t sum_us;
+} metrics_hist_t;
+
+// Written by Core0 only.
+typedef struct __attribute__((aligned(32)))
+{
+    uint32_t spi_transactions;
+    uint32_t spi_decode_errors; // frames that cannot be a slave reply (bus floating, no slave)
+    uint32_t loops;
+    metrics_hist_t loop_us; // one pass of the main loop, without the poll wait
+    metrics_hist_t spi_us;  // one SPI exchange, chip select to chip select
+} metrics_core0_t;
+
+// Written by Core1 only. Index METRICS_MAX_ROUTES collects requests that matched no route.
+typedef struct __attribute__((aligned(32)))
+{
+    uint32_t http_requests[METRICS_MAX_ROUTES + 1][6]; // by status class, [0] = no response
+    metrics_hist_t http_us;                            // request complete to response queued
+} metrics_core1_t;
+
+static metrics_core0_t metrics_core0;
+static metrics_core1_t metrics_core1;
+
+#if PICO_ON_DEVICE
+#include <malloc.h>
+extern char __StackLimit, __bss_end__; // heap bounds from the SDK linker script
+
+// Free C heap: everything between the end of .bss and the stack limit, minus what malloc handed out.
+static uint32_t metrics_heap_free(void)
+{
+    struct mallinfo mi = mallinfo();
+    return (uint32_t)(&__StackLimit - &__bss_end__) - mi.uordblks;
+}
+#endif
+
+static inline void metrics_observe(metrics_hist_t *h, uint32_t us)
+{
+    int i = 0;
+    while (i < METRICS_BUCKETS && us > metrics_bounds_us[i])
+        i++;
+    h->bucket[i]++;
+    h->count++;
+    h->sum_us += us;
+}
+
+/* ===================== EXPOSITION ===================== */
+
+typedef struct
+{
+    char *buf;
+    int cap;
+    int len;
+    bool overflow;
+} metrics_out_t;
+
+static void metrics_printf(metrics_out_t *m, const char *fmt, ...)
+{
+    if (m->overflow)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(m->buf + m->len, m->cap - m->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || n >= m->cap - m->len)
+        m->overflow = true;
+    else
+        m->len += n;
+}
+
+static void metrics_header(metrics_out_t *m, const char *name, const char *type, const char *help)
+{
+    metrics_printf(m, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// One sample. labels is either "" or a complete {a="b",...} block.
+static void metrics_value(metrics_out_t *m, const char *name, const char *labels, uint64_t value)
+{
+    metrics_printf(m, "%s%s %llu\n", name, labels, (unsigned long long)value);
+}
+
+static void metrics_counter(metrics_out_t *m, const char *name, const char *help, const char *labels,
+                            uint64_t value)
+{
+    metrics_header(m, name, "counter", help);
+    metrics_value(m, name, labels, value);
+}
+
+static void metrics_gauge(metrics_out_t *m, const char *name, const char *help, const char *labels,
+                          uint64_t value)
+{
+    metrics_header(m, name, "gauge", help);
+    metrics_value(m, name, labels, value);
+}
+
+// Buckets are cumulative in the exposition format and in seconds.
+static void metrics_histogram(metrics_out_t *m, const char *name, const char *help, const char *core,
+                              const metrics_hist_t *h)
+{
+    uint32_t cumulative = 0;
+
+    metrics_header(m, name, "histogram", help);
+    for (int i = 0; i < METRICS_BUCKETS; i++)
+    {
+        cumulative += h->bucket[i];
+        metrics_printf(m, "%s_bucket{core=\"%s\",le=\"%lu.%06lu\"} %lu\n", name, core,
+                       (unsigned long)(metrics_bounds_us[i] / 1000000),
+                       (unsigned long)(metrics_bounds_us[i] % 1000000), (unsigned long)cumulative);
+    }
+    cumulative += h->bucket[METRICS_BUCKETS];
+    metrics_printf(m, "%s_bucket{core=\"%s\",le=\"+Inf\"} %lu\n", name, core, (unsigned long)cumulative);
+    metrics_printf(m, "%s_sum{core=\"%s\"} %llu.%06llu\n", name, core,
+                   (unsigned long long)(h->sum_us / 1000000), (unsigned long long)(h->sum_us % 1000000));
+    metrics_printf(m, "%s_count{core=\"%s\"} %lu\n", name, core, (unsigned long)h->count);
+}
+
+#endif
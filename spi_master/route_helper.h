@@ -0,0 +1,348 @@
+#ifndef ROUTE_HELPER_H
+#define ROUTE_HELPER_H
+
+// This is route_helper.h, the dispatcher for the Core1 HTTP server.
+// Routes are declared once, as a const table of method + path + handler + limits (see http_routes[] in
+// http_helper.h). At boot, route_table_compile() hashes every exact path into a small open-addressed
+// index, so a lookup is one hash over the request path and (almost always) one probe, no matter how
+// many endpoints we add. Prefix routes are kept on a short side list, longest first, and are only
+// walked when the exact lookup misses.
+
+#include "lwip/tcp.h"
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ROUTE_INDEX_SIZE 32 // power of two, keep it at least twice the number of exact routes
+#define ROUTE_PREFIX_MAX 8
+#define ROUTE_NONE 0xFF
+
+/* Methods are bit flags so one route can accept several of them. */
+typedef enum
+{
+    HTTP_METHOD_UNKNOWN = 0,
+    HTTP_GET = 1 << 0,
+    HTTP_POST = 1 << 1,
+    HTTP_PUT = 1 << 2,
+    HTTP_DELETE = 1 << 3,
+    HTTP_HEAD = 1 << 4,
+    HTTP_OPTIONS = 1 << 5,
+} http_method_t;
+
+typedef enum
+{
+    ROUTE_EXACT = 0,
+    ROUTE_PREFIX = 1,
+} route_match_t;
+
+/* A parsed request. Every pointer points into the caller's request buffer. */
+typedef struct
+{
+    http_method_t method;
+    const char *path;
+    uint16_t path_len;
+    const char *query; // NULL when the target had no '?'
+    uint16_t query_len;
+    const char *headers; // first header line, NOT NUL terminated at the blank line
+    uint16_t headers_len;
+    const char *body; // NUL terminated (the request buffer is)
+    uint16_t body_len;
+    int32_t content_length; // -1 when the header is absent
+} http_request_t;
+
+typedef void (*route_handler_fn)(struct tcp_pcb *pcb, const http_request_t *req);
+
+typedef struct
+{
+    uint8_t methods; // OR of http_method_t
+    route_match_t match;
+    const char *path;
+    uint16_t path_len;
+    uint16_t max_body; // largest body the route accepts, 0 = no body
+    uint8_t prio;      // lwIP PCB priority (TCP_PRIO_MIN..TCP_PRIO_MAX) once the request is routed
+    route_handler_fn handler;
+} http_route_t;
+
+// ROUTE() keeps path_len a compile-time constant so nobody has to count characters.
+#define ROUTE(methods, match, path, max_body, prio, handler) \
+    {(methods), (match), (path), sizeof(path) - 1, (max_body), (prio), (handler)}
+
+typedef enum
+{
+    ROUTE_FOUND = 0,
+    ROUTE_NOT_FOUND,          // 404
+    ROUTE_METHOD_NOT_ALLOWED, // 405
+} route_result_t;
+
+typedef struct
+{
+    const http_route_t *routes;
+    uint8_t count;
+    uint8_t index[ROUTE_INDEX_SIZE]; // route number, or ROUTE_NONE
+    uint8_t prefix[ROUTE_PREFIX_MAX];
+    uint8_t prefix_count;
+} route_table_t;
+
+/* ===================== HASHING ===================== */
+
+// FNV-1a, 32 bit. Cheap on the M33/Hazard3 and good enough for a table this size.
+static inline uint32_t route_hash(const char *s, uint16_t len)
+{
+    uint32_t h = 2166136261u;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* ===================== COMPILE ===================== */
+
+// Builds the hash index. Returns false if the table does not fit, which is a programming error:
+// grow ROUTE_INDEX_SIZE / ROUTE_PREFIX_MAX.
+static bool route_table_compile(route_table_t *t, const http_route_t *routes, uint8_t count)
+{
+    memset(t, 0, sizeof(*t));
+    memset(t->index, ROUTE_NONE, sizeof(t->index));
+    t->routes = routes;
+    t->count = count;
+
+    uint8_t exact = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (routes[i].match == ROUTE_PREFIX)
+        {
+            if (t->prefix_count >= ROUTE_PREFIX_MAX)
+                return false;
+
+            // insertion sort, longest prefix first
+            uint8_t j = t->prefix_count++;
+            while (j > 0 && routes[t->prefix[j - 1]].path_len < routes[i].path_len)
+            {
+                t->prefix[j] = t->prefix[j - 1];
+                j--;
+            }
+            t->prefix[j] = i;
+            continue;
+        }
+
+        if (++exact > ROUTE_INDEX_SIZE / 2)
+            return false;
+
+        uint32_t slot = route_hash(routes[i].path, routes[i].path_len) & (ROUTE_INDEX_SIZE - 1);
+        while (t->index[slot] != ROUTE_NONE)
+        {
+            slot = (slot + 1) & (ROUTE_INDEX_SIZE - 1);
+        }
+        t->index[slot] = i;
+    }
+    return true;
+}
+
+/* ===================== LOOKUP ===================== */
+
+static route_result_t route_table_find(const route_table_t *t, http_method_t method,
+                                       const char *path, uint16_t path_len,
+                                       const http_route_t **out)
+{
+    bool path_seen = false;
+    *out = NULL;
+
+    uint32_t slot = route_hash(path, path_len) & (ROUTE_INDEX_SIZE - 1);
+    while (t->index[slot] != ROUTE_NONE)
+    {
+        const http_route_t *r = &t->routes[t->index[slot]];
+        if (r->path_len == path_len && memcmp(r->path, path, path_len) == 0)
+        {
+            if (r->methods & method)
+            {
+                *out = r;
+                return ROUTE_FOUND;
+            }
+            path_seen = true; // same path, other method; keep probing
+        }
+        slot = (slot + 1) & (ROUTE_INDEX_SIZE - 1);
+    }
+
+    for (uint8_t i = 0; i < t->prefix_count; i++)
+    {
+        const http_route_t *r = &t->routes[t->prefix[i]];
+        if (r->path_len <= path_len && memcmp(r->path, path, r->path_len) == 0)
+        {
+            if (r->methods & method)
+            {
+                *out = r;
+                return ROUTE_FOUND;
+            }
+            path_seen = true;
+        }
+    }
+
+    return path_seen ? ROUTE_METHOD_NOT_ALLOWED : ROUTE_NOT_FOUND;
+}
+
+/* ===================== REQUEST PARSING ===================== */
+
+static http_method_t http_parse_method(const char *s, uint16_t len)
+{
+    switch (len)
+    {
+    case 3:
+        if (memcmp(s, "GET", 3) == 0)
+            return HTTP_GET;
+        if (memcmp(s, "PUT", 3) == 0)
+            return HTTP_PUT;
+        break;
+    case 4:
+        if (memcmp(s, "POST", 4) == 0)
+            return HTTP_POST;
+        if (memcmp(s, "HEAD", 4) == 0)
+            return HTTP_HEAD;
+        break;
+    case 6:
+        if (memcmp(s, "DELETE", 6) == 0)
+            return HTTP_DELETE;
+        break;
+    case 7:
+        if (memcmp(s, "OPTIONS", 7) == 0)
+            return HTTP_OPTIONS;
+        break;
+    }
+    return HTTP_METHOD_UNKNOWN;
+}
+
+// Case-insensitive header lookup. Returns a pointer to the value (leading blanks skipped) and its
+// length up to the CR, or NULL.
+static const char *http_find_header(const http_request_t *req, const char *name, uint16_t *value_len)
+{
+    size_t name_len = strlen(name);
+    const char *p = req->headers;
+    const char *end = req->headers + req->headers_len;
+
+    while (p && p < end)
+    {
+        const char *eol = memchr(p, '\r', end - p);
+        if (!eol)
+            eol = end;
+
+        if ((size_t)(eol - p) > name_len && p[name_len] == ':' && strncasecmp(p, name, name_len) == 0)
+        {
+            const char *v = p + name_len + 1;
+            while (v < eol && (*v == ' ' || *v == '\t'))
+                v++;
+            *value_len = (uint16_t)(eol - v);
+            return v;
+        }
+        p = eol + 2; // skip CRLF
+    }
+    return NULL;
+}
+
+// Raw value of query parameter name (?name=value&...), not URL-decoded. NULL when absent.
+static const char *http_query_param(const http_request_t *req, const char *name, uint16_t *value_len)
+{
+    size_t name_len = strlen(name);
+    const char *p = req->query;
+    const char *end = req->query + req->query_len;
+
+    while (p && p < end)
+    {
+        const char *amp = memchr(p, '&', end - p);
+        if (!amp)
+            amp = end;
+
+        if ((size_t)(amp - p) > name_len && p[name_len] == '=' && memcmp(p, name, name_len) == 0)
+        {
+            *value_len = (uint16_t)(amp - (p + name_len + 1));
+            return p + name_len + 1;
+        }
+        p = amp + 1;
+    }
+    return NULL;
+}
+
+// Unsigned integer query parameter (?name=123&...). Returns fallback when absent or not a number.
+static uint32_t http_query_uint(const http_request_t *req, const char *name, uint32_t fallback)
+{
+    uint16_t vlen;
+    const char *v = http_query_param(req, name, &vlen);
+    if (!v || vlen == 0 || *v < '0' || *v > '9')
+        return fallback;
+
+    uint32_t n = 0;
+    for (uint16_t i = 0; i < vlen && v[i] >= '0' && v[i] <= '9'; i++)
+        n = n * 10 + (uint32_t)(v[i] - '0');
+    return n;
+}
+
+// True if the Accept header lists type. Plain substring match; q-values are ignored.
+static bool http_accepts(const http_request_t *req, const char *type)
+{
+    uint16_t vlen;
+    const char *v = http_find_header(req, "Accept", &vlen);
+    size_t type_len = strlen(type);
+
+    if (!v)
+        return false;
+    for (uint16_t i = 0; i + type_len <= vlen; i++)
+        if (strncasecmp(v + i, type, type_len) == 0)
+            return true;
+    return false;
+}
+
+// Splits "METHOD /path?query HTTP/1.1\r\nheaders\r\n\r\nbody" in place. buf must be NUL terminated.
+// Returns false when the request line is malformed or the header block is incomplete.
+static bool http_parse_request(const char *buf, uint16_t len, http_request_t *req)
+{
+    memset(req, 0, sizeof(*req));
+    req->content_length = -1;
+
+    const char *end = buf + len;
+    const char *sp = memchr(buf, ' ', len);
+    if (!sp)
+        return false;
+    req->method = http_parse_method(buf, (uint16_t)(sp - buf));
+
+    const char *target = sp + 1;
+    const char *target_end = memchr(target, ' ', end - target);
+    if (!target_end || *target != '/')
+        return false;
+
+    const char *q = memchr(target, '?', target_end - target);
+    req->path = target;
+    req->path_len = (uint16_t)((q ? q : target_end) - target);
+    if (q)
+    {
+        req->query = q + 1;
+        req->query_len = (uint16_t)(target_end - req->query);
+    }
+
+    const char *eol = strstr(target_end, "\r\n");
+    const char *blank = strstr(target_end, "\r\n\r\n");
+    if (!eol || !blank)
+        return false;
+
+    req->headers = eol + 2;
+    req->headers_len = (blank >= req->headers) ? (uint16_t)(blank + 2 - req->headers) : 0;
+    req->body = blank + 4;
+    req->body_len = (uint16_t)(end - req->body);
+
+    uint16_t vlen;
+    const char *cl = http_find_header(req, "Content-Length", &vlen);
+    if (cl)
+    {
+        req->content_length = 0;
+        for (uint16_t i = 0; i < vlen && cl[i] >= '0' && cl[i] <= '9'; i++)
+        {
+            // A length that does not fit is malformed (400), never a wrapped negative one
+            if (req->content_length > (INT32_MAX - (cl[i] - '0')) / 10)
+                return false;
+            req->content_length = req->content_length * 10 + (cl[i] - '0');
+        }
+    }
+    return true;
+}
+
+#endif
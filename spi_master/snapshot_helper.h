@@ -0,0 +1,145 @@
+#ifndef SNAPSHOT_HELPER_H
+#define SNAPSHOT_HELPER_H
+
+// This is snapshot_helper.h. Core0 owns the slave data, Core1 owns the network, and GET /api/status sits
+// in between. Instead of Core1 reading four volatile globals (which Core0 can change halfway through)
+// and formatting them on every request, Core0 formats the complete response - headers and body - once
+// per SPI exchange, into one of a few slots, and then flips status_live to point at it. Each slot holds
+// the response twice, as JSON and as the packed record from telemetry_helper.h, so content negotiation
+// on Core1 is just picking a buffer.
+//
+// Core1 pins the live slot with a reference count, hands the bytes to tcp_write() and unpins it.
+// Core0 only ever rewrites a slot that is neither live nor pinned. The pin/flip pair is the usual
+// store -> barrier -> load handshake, so one side always sees the other: either Core0 sees the pin and
+// leaves the slot alone, or Core1 sees the flip and pins the new slot instead.
+
+#include "hardware/sync.h"
+#include "telemetry_helper.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define STATUS_SNAPSHOT_SLOTS 3 // Core1 pins at most one slot, so Core0 always has a free one
+#define STATUS_SNAPSHOT_MAX 256
+#define STATUS_SNAPSHOT_BIN_MAX 128
+
+typedef struct
+{
+    uint32_t version; // bumps on every publish
+    uint16_t len;     // bytes used in buf
+    uint16_t bin_len; // bytes used in bin
+    char buf[STATUS_SNAPSHOT_MAX];
+    char bin[STATUS_SNAPSHOT_BIN_MAX];
+} status_snapshot_t;
+
+static status_snapshot_t status_snapshots[STATUS_SNAPSHOT_SLOTS];
+static volatile uint8_t status_live = 0;                    // written by Core0 only
+static volatile uint8_t status_pins[STATUS_SNAPSHOT_SLOTS]; // written by Core1 only
+static volatile uint32_t status_version = 0;                // written by Core0 only
+static volatile uint32_t status_publish_skipped = 0;        // written by Core0 only
+
+/* ===================== CORE0 SIDE ===================== */
+
+// Formats a complete HTTP response into a free slot and makes it live. Returns false if no slot was
+// free (cannot happen with one reader, but the caller just tries again next loop if it does).
+static bool status_snapshot_publish(uint32_t raw, uint16_t temperature, uint8_t led, uint16_t applied)
+{
+    uint8_t live = status_live;
+    uint8_t next = STATUS_SNAPSHOT_SLOTS;
+
+    for (uint8_t i = 0; i < STATUS_SNAPSHOT_SLOTS; i++)
+    {
+        if (i != live && status_pins[i] == 0)
+        {
+            next = i;
+            break;
+        }
+    }
+    if (next == STATUS_SNAPSHOT_SLOTS)
+    {
+        status_publish_skipped++;
+        return false;
+    }
+
+    status_snapshot_t *s = &status_snapshots[next];
+    uint32_t version = status_version + 1;
+
+    uint32_t timestamp = (uint32_t)time(NULL);
+
+    char body[128];
+    int body_len = snprintf(body, sizeof(body),
+                            "{"
+                            "\"raw\":%lu,"
+                            "\"temperature\":%u,"
+                            "\"led\":%u,"
+                            "\"timestamp\":%lu,"
+                            "\"seq\":%lu,"
+                            "\"applied\":%u"
+                            "}",
+                            (unsigned long)raw,
+                            temperature,
+                            led,
+                            (unsigned long)timestamp,
+                            (unsigned long)version,
+                            applied);
+
+    int header_len = snprintf(s->buf, sizeof(s->buf),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: %d\r\n"
+                              "Connection: close\r\n\r\n",
+                              body_len);
+
+    if (header_len + body_len > (int)sizeof(s->buf))
+    {
+        status_publish_skipped++;
+        return false;
+    }
+    memcpy(s->buf + header_len, body, body_len);
+    s->len = (uint16_t)(header_len + body_len);
+
+    header_len = snprintf(s->bin, sizeof(s->bin),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: " TELEMETRY_CONTENT_TYPE "\r\n"
+                          "Content-Length: %d\r\n"
+                          "Connection: close\r\n\r\n",
+                          TELEMETRY_STATUS_LEN);
+    s->bin_len = (uint16_t)(header_len + telemetry_status_encode((uint8_t *)s->bin + header_len, raw,
+                                                                 temperature, led, timestamp, version,
+                                                                 applied));
+    s->version = version;
+
+    __dmb(); // slot contents before the flip
+    status_version = version;
+    status_live = next;
+    __dmb(); // flip before the next publish looks at the pins
+    return true;
+}
+
+/* ===================== CORE1 SIDE ===================== */
+
+static const status_snapshot_t *status_snapshot_acquire(uint8_t *slot)
+{
+    for (;;)
+    {
+        uint8_t idx = status_live;
+        status_pins[idx]++;
+        __dmb(); // pin before re-checking the flip
+        if (status_live == idx)
+        {
+            *slot = idx;
+            return &status_snapshots[idx];
+        }
+        status_pins[idx]--; // Core0 moved on while we pinned; take the new one
+    }
+}
+
+static void status_snapshot_release(uint8_t slot)
+{
+    __dmb(); // finish reading the slot before Core0 may reuse it
+    status_pins[slot]--;
+}
+
+#endif
@@ -7,12 +7,14 @@
 //
 // Combining a master configuration over an SPI bus, with http functionality.
 // Written for the Raspberry Pi Pico 2W to act as a master, making requests of the slave (a Raspberry Pi Pico).
-// The Pico 2W also communicates with an unrelated microcontroller over UART, sending it the temperature
-// received from the Pico slave, and whatever text messages are sent from the interactive web page.
+// The Pico 2W also communicates with an unrelated microcontroller, sending it the temperature received
+// from the Pico slave over UART, and whatever text messages are sent from the interactive web page over
+// Wi-Fi.
 //
-// The master receives three bytes from the slave: The MSB (byte 0) and the middle byte (byte 1) contain the
-// value registered by the Pico slave's ADC, which is reading an external thermistor.
-// Byte #2 from the slave contains these LED states:
+// The master receives three bytes from the slave: byte 0 and the low nibble of byte 1 contain the
+// value registered by the Pico slave's ADC, which is reading an external thermistor. Byte 2 echoes the
+// ID of the last LED command the slave applied (see control_helper.h for the whole protocol).
+// The high nibble of byte 1 contains these LED states:
 //  0 (00000000) = off;
 //  1 (00000001) = green;
 //  2 (00000020) = yellow;
@@ -43,20 +45,57 @@
 #include "hardware/uart.h"
 #include "spi_master.h"
 #include "wifi_master.h"
+#include "uart_link_helper.h"
 #include "http_helper.h"
 #include "core_helper.h"
 #include <limits.h>
 
-#define UART_ID uart1
-#define BAUD_RATE 115200
+#define UART_ID uart1 // COBS-framed binary link to the ESP32, see uart_link_helper.h
 
 #define UART_TX_PIN 4
 #define UART_RX_PIN 5
 
-const uint ESP_READY_PIN = 3;
+// Flow control with the ESP32 (uart_link_helper.h)
+#define ESP_REQ_PIN 3   // out, to ESP32 GPIO7: low while frames are queued
+#define ESP_READY_PIN 2 // in, from ESP32 GPIO9: high while it can take more
 const uint LED_PIN = 0;
 
+#define POLL_MS_DEFAULT 3000
+#define POLL_MS_MIN 250
+#define POLL_MS_MAX 60000
+
 uint8_t loop_count = 0;
+uint32_t poll_ms = POLL_MS_DEFAULT;
+
+// Drains one batch from the command queue (cmdq_helper.h). LED commands are merged into the frame for
+// this loop's SPI exchange; CMD_READ needs nothing here, since its arrival already cut the poll wait
+// short.
+static void dispatch_commands(void)
+{
+    cmd_t cmd;
+    int n = 0;
+
+    while (n < CMDQ_BATCH && cmdq_pop(&cmd))
+    {
+        n++;
+        switch (cmd.type)
+        {
+        case CMD_LED_SET:
+            ctl_merge(cmd.led.id, cmd.led.mask, cmd.led.value);
+            break;
+        case CMD_CONFIG:
+            if (cmd.config.key == CFG_POLL_MS)
+                poll_ms = cmd.config.value < POLL_MS_MIN   ? POLL_MS_MIN
+                          : cmd.config.value > POLL_MS_MAX ? POLL_MS_MAX
+                                                           : cmd.config.value;
+            break;
+        default:
+            break;
+        }
+    }
+    if (n)
+        cmdq_batches++;
+}
 
 void print_byte_binary(unsigned char byte)
 {
@@ -135,6 +174,8 @@ int main()
 {
     // --- Init stdio & networking ---
     stdio_init_all();
+    status_snapshot_publish(0, 0, 0, 0); // so Core1 never serves an empty slot
+    cmdq_init();
     multicore_launch_core1(core1_main);
 
 #if !defined(SPI_PORT) || !defined(PIN_SCK) || \
@@ -147,108 +188,80 @@ int main()
     // --- SPI setup ---
     spi_setup();
 
-    uint8_t spi_tx[3] = {0x00, 0x00, 0x00};
     uint8_t spi_rx[3] = {0x00, 0x00, 0x00};
     uint8_t tx_cmd = 0;
-    uint8_t slave_cmd = 0;
 
     gpio_init(LED_PIN);
     gpio_set_dir(LED_PIN, GPIO_OUT);
 
-    gpio_init(ESP_READY_PIN);
-    gpio_set_dir(ESP_READY_PIN, GPIO_OUT);
-
-    // Initialize UART
-    uart_init(UART_ID, BAUD_RATE);
-
-    gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
-
-    gpio_put(ESP_READY_PIN, 1);
+    // UART link to the ESP32: DMA in both directions, paced by its ready line, Core0 never waits on it
+    link_init(UART_ID, UART_TX_PIN, UART_RX_PIN, ESP_REQ_PIN, ESP_READY_PIN);
 
     tx_cmd = 0; // toggling tx_cmd off here.
 
     while (true)
     {
-        /*
-         * Byte 2 is the command byte.
-         * It is set by POST /api/control.
-         * We consume it ONCE and immediately clear it.
-         */
+        uint32_t loop_t0 = time_us_32();
 
-        /* Pull command ONCE */
-        if (pending_cmd != 0)
-        {
-            slave_cmd = pending_cmd;
-            pending_cmd = 0;
-        }
-
-        /* Build TX frame — NO RX FEEDBACK */
-        uint8_t tx_buf[3] = {0x00, 0x00, slave_cmd};
-        uint8_t rx_buf[3] = {0};
-
-        slave_cmd = 0; // zero out so it doesn't keep sending the same command.
-
-        /* Process RX only */
         /*
-        current_temp_raw = ((uint16_t)rx_buf[1] << 8) | rx_buf[0];
-        current_led_byte = rx_buf[2];
-        */
+         * The TX frame carries the LED state Core1 was asked for, tagged with a command ID, and keeps
+         * carrying it until the slave echoes the ID back (control_helper.h).
+         */
+        dispatch_commands();
+        uint8_t tx_buf[3];
+        ctl_next_frame(tx_buf);
 
-        spi_tx[2] = tx_cmd;
-        // tx_cmd = 0; // toggling tx_cmd off here.
         //  --- SPI transaction ---
+        uint32_t spi_t0 = time_us_32();
         uint32_t spi_value = spi_readwrite(tx_buf, spi_rx);
+        metrics_observe(&metrics_core0.spi_us, time_us_32() - spi_t0);
+        metrics_core0.spi_transactions++;
+        bool frame_ok = !(spi_rx[0] == 0xFF && spi_rx[1] == 0xFF && spi_rx[2] == 0xFF);
+        if (!frame_ok)
+            metrics_core0.spi_decode_errors++; // MISO floating high: no slave on the bus
 
-        slave_output = ((uint16_t)spi_rx[2] << 16) | ((uint16_t)spi_rx[1] << 8) | spi_rx[0];
+        slave_output = spi_value; // the three bytes, byte 0 lowest
         printf("slave_output : %d\n", slave_output);
 
         // --- Decode SPI response ---
         uint16_t temp_raw =
-            ((uint16_t)spi_rx[1] << 8) | spi_rx[0];
+            ((uint16_t)(spi_rx[1] & 0x0F) << 8) | spi_rx[0];
+        uint8_t led_state = spi_rx[1] >> 4;
+        if (frame_ok)
+            ctl_on_reply(spi_rx[2]); // 0xFF from a dead bus must not pass for an echo of ID 255
 
         float temp_c = getTemperature(temp_raw);
         float temp_f = (temp_c * 9.0f / 5.0f) + 32.0f;
 
         // --- Update globals used by HTTP API ---
         current_temp_raw = (uint16_t)temp_f;
-        current_led_byte = spi_rx[2];
-
-        gpio_put(ESP_READY_PIN, 0);
-
-        // Send numeric command instead of "Hello"
-        char uart_buf[32];
-        snprintf(uart_buf, sizeof(uart_buf), "CMD=%d %d\n", (int)temp_f, (int)temp_c);
-        uart_puts(UART_ID, uart_buf);
-
-        // Read response (non-blocking)
-        while (uart_is_readable(UART_ID))
-        {
-            char c = uart_getc(UART_ID);
-            putchar(c); // prints to USB console
-        }
+        current_led_byte = led_state;
+        status_snapshot_publish(slave_output, current_temp_raw, current_led_byte, ctl_applied);
+        history_push(to_ms_since_boot(get_absolute_time()), slave_output, current_temp_raw, current_led_byte);
+
+        // Full telemetry for every exchange, the same record as binary /api/status. link_send only
+        // queues it for the DMA; replies from the ESP32 are decoded by link_poll.
+        uint8_t telemetry[TELEMETRY_STATUS_LEN];
+        telemetry_status_encode(telemetry, slave_output, current_temp_raw, current_led_byte,
+                                (uint32_t)time(NULL), status_version, ctl_applied);
+        link_send(LINK_MSG_TELEMETRY, telemetry, sizeof(telemetry));
+        link_poll();
 
         printf("TX CMD = %u\n", tx_cmd);
         loop_count = 1;
         tx_cmd++;
 
-        gpio_put(ESP_READY_PIN, 1);
-        sleep_ms(10);
-
-        if (text_pending)
-        {
-            char uart_buf[40];
-            snprintf(uart_buf, sizeof(uart_buf), "TXT=%s\n", pending_text);
-            uart_puts(UART_ID, uart_buf);
-            text_pending = 0;
-        }
-
         gpio_put(LED_PIN, 1);
         sleep_ms(20);
         gpio_put(LED_PIN, 0);
 
+        metrics_core0.loops++;
+        metrics_observe(&metrics_core0.loop_us, time_us_32() - loop_t0);
+
         // --- Poll interval ---
-        sleep_ms(3000);
+        // Shorter while a command waits for its echo; a new command from Core1 cuts it short. The UART
+        // link is serviced throughout, see link_wait_ms.
+        link_wait_ms(ctl_poll_ms(poll_ms));
     }
 #endif
 }
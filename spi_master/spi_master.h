@@ -47,7 +47,6 @@ static inline uint32_t pack24(uint8_t b0, uint8_t b1, uint8_t b2)
 
 float getTemperature(uint16_t raw_adc)
 {
-    uint16_t conversion = 0;
     // Function definition: calculates the sum and returns it.
     float temperature_c;
     // Convert raw ADC to voltage
@@ -59,7 +58,6 @@ float getTemperature(uint16_t raw_adc)
     float steinhart_temp_k = 1.0 / ((1.0 / (T_NOMINAL + 273.15)) + (log(thermistor_resistance / R_NOMINAL) / B_COEFFICIENT));
     // Convert Kelvin to Celsius
     temperature_c = steinhart_temp_k - 273.15; // Calculate Centigrade.
-    conversion = (int)temperature_c;
     return temperature_c;
 }
 
@@ -0,0 +1,89 @@
+#ifndef TELEMETRY_HELPER_H
+#define TELEMETRY_HELPER_H
+
+// This is telemetry_helper.h, the packed binary form of /api/status and /api/history for machine clients.
+// A client gets it by sending "Accept: application/octet-stream" or adding ?fmt=bin; everyone else keeps
+// getting JSON. All fields are little-endian and written byte by byte, so the layout does not depend on
+// the compiler's struct packing or on the host the decoder runs on.
+//
+// Status record, 20 bytes:
+//   0  u8  kind (TELEMETRY_STATUS)      1  u8  led
+//   2  u16 temperature                  4  u32 raw
+//   8  u32 timestamp (s)               12  u32 seq
+//  16  u16 applied (last control request ID the slave confirmed)    18  u16 reserved
+//
+// History, a 16 byte header followed by count samples of 12 bytes each. Samples are consecutive, so
+// sample i has seq first + i and only the first seq is sent:
+//   0  u8  kind (TELEMETRY_HISTORY)     1  u8  flags (bit0 more, bit1 gap)
+//   2  u16 count                        4  u32 first seq
+//   8  u32 head                        12  u32 now (ms since boot)
+// then per sample:
+//   0  u32 t_ms    4  u32 raw    8  u16 temperature    10  u8 led    11  u8 reserved
+// "next" in JSON terms is first + count - 1, which is the request's since when count is 0.
+
+#include <stdint.h>
+
+#define TELEMETRY_CONTENT_TYPE "application/octet-stream"
+
+#define TELEMETRY_STATUS 1
+#define TELEMETRY_HISTORY 2
+
+#define TELEMETRY_STATUS_LEN 20
+#define TELEMETRY_HISTORY_HEADER_LEN 16
+#define TELEMETRY_HISTORY_SAMPLE_LEN 12
+
+#define TELEMETRY_FLAG_MORE 0x01
+#define TELEMETRY_FLAG_GAP 0x02
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline int telemetry_status_encode(uint8_t *out, uint32_t raw, uint16_t temperature, uint8_t led,
+                                          uint32_t timestamp, uint32_t seq, uint16_t applied)
+{
+    out[0] = TELEMETRY_STATUS;
+    out[1] = led;
+    put_le16(out + 2, temperature);
+    put_le32(out + 4, raw);
+    put_le32(out + 8, timestamp);
+    put_le32(out + 12, seq);
+    put_le16(out + 16, applied);
+    put_le16(out + 18, 0);
+    return TELEMETRY_STATUS_LEN;
+}
+
+static inline int telemetry_history_header(uint8_t *out, uint8_t flags, uint16_t count, uint32_t first,
+                                           uint32_t head, uint32_t now)
+{
+    out[0] = TELEMETRY_HISTORY;
+    out[1] = flags;
+    put_le16(out + 2, count);
+    put_le32(out + 4, first);
+    put_le32(out + 8, head);
+    put_le32(out + 12, now);
+    return TELEMETRY_HISTORY_HEADER_LEN;
+}
+
+static inline int telemetry_history_sample(uint8_t *out, uint32_t t_ms, uint32_t raw, uint16_t temperature,
+                                           uint8_t led)
+{
+    put_le32(out, t_ms);
+    put_le32(out + 4, raw);
+    put_le16(out + 8, temperature);
+    out[10] = led;
+    out[11] = 0;
+    return TELEMETRY_HISTORY_SAMPLE_LEN;
+}
+
+#endif
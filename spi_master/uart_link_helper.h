@@ -0,0 +1,335 @@
+#ifndef UART_LINK_HELPER_H
+#define UART_LINK_HELPER_H
+
+// This is uart_link_helper.h, the DMA-driven UART link from Core0 to the ESP32 (frame format in
+// link_codec_helper.h). The old code called uart_puts() at 115200 baud, which spins until every
+// character is in the FIFO, and drained replies with uart_getc() one byte at a time. Now neither
+// direction costs Core0 more than a memcpy:
+//
+//   TX  link_send() encodes a frame into a ring in SRAM and returns. A DMA channel paced by the UART's
+//       TX DREQ sends the ring out; its completion interrupt (on Core0) starts the next contiguous
+//       chunk. A full ring drops the frame and counts it, it never waits.
+//   RX  a second DMA channel copies every received byte into a ring that wraps in hardware
+//       (LINK_RX_BITS). link_poll() walks from its read index to the channel's write address and feeds
+//       the decoder. Nothing is ever read from the UART by the CPU.
+//
+// The link boots at LINK_BAUD_BOOT. link_poll() offers LINK_BAUD_FAST with a HELLO every
+// LINK_HELLO_MS; the ESP32 switches right after sending HELLO_ACK, so from the moment it arrives the
+// master holds TX (queued frames stay in the ring) until the chunk on the wire has drained, switches,
+// and lets TX go again. link_wait_ms() polls the link while Core0 idles, so that happens within
+// LINK_SERVICE_MS. An ESP32 that never answers just leaves the link at the boot rate.
+//
+// Both sides watch for silence once fast. The ESP32 sends LINK_MSG_STATS every second, and the master
+// sends LINK_MSG_KEEPALIVE whenever it has sent nothing for LINK_KEEPALIVE_MS, since a poll interval
+// can be far longer than LINK_SILENCE_MS. If nothing valid arrives for LINK_SILENCE_MS (the ESP32
+// rebooted and is back at the boot rate), the master drops back to LINK_BAUD_BOOT and negotiates again.
+//
+// Flow control is two GPIO lines. The master pulls its request line low while it has frames queued;
+// the ESP32's interrupt on that edge wakes a task that answers on the ready line: high while it has
+// room, low while its receive buffer is backing up. TX only starts a DMA chunk while ready is high, and
+// chunks are at most LINK_TX_CHUNK bytes, so a busy ESP32 receives at most one more chunk. A rising
+// edge on ready restarts TX from a GPIO interrupt; nothing waits or sleeps. Frames queued while the
+// ESP32 is busy stay in the ring, and are dropped only if it fills. The ready input is pulled up, so a
+// board without the wire behaves as if the ESP32 were always ready.
+//
+// Core0 only: link_send(), link_poll() and the DMA and GPIO interrupts all run there.
+
+#include "hardware/uart.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include "link_codec_helper.h"
+#include "telemetry_helper.h"
+#include "cmdq_helper.h"
+#include <stdio.h>
+
+#define LINK_BAUD_BOOT 115200
+#define LINK_BAUD_FAST 921600
+#define LINK_HELLO_MS 1000
+#define LINK_SILENCE_MS 5000   // same on the ESP32
+#define LINK_KEEPALIVE_MS 1000 // well inside LINK_SILENCE_MS, so a lost keepalive or two does not matter
+#define LINK_SERVICE_MS 100    // longest link_wait_ms() goes without polling the link
+#define LINK_TX_SIZE 1024 // power of two
+#define LINK_TX_CHUNK 64  // most a busy ESP32 can still receive, about 0.7 ms at LINK_BAUD_FAST
+#define LINK_RX_BITS 10   // RX ring of 1 << LINK_RX_BITS bytes
+#define LINK_RX_SIZE (1u << LINK_RX_BITS)
+
+static uart_inst_t *link_uart;
+static int link_tx_dma = -1;
+static int link_rx_dma = -1;
+static uint link_req_pin;   // output, low = frames queued
+static uint link_ready_pin; // input, high = the ESP32 has room
+
+static uint8_t link_tx_ring[LINK_TX_SIZE];
+static volatile uint32_t link_tx_head = 0;     // bytes queued, ever
+static volatile uint32_t link_tx_tail = 0;     // bytes the DMA has finished with, ever
+static volatile uint32_t link_tx_inflight = 0; // bytes in the running DMA transfer
+static uint8_t link_tx_seq = 0;
+
+static uint8_t link_rx_ring[LINK_RX_SIZE] __attribute__((aligned(LINK_RX_SIZE)));
+static uint32_t link_rx_read = 0;
+static link_rx_t link_rx;
+
+static uint32_t link_baud = LINK_BAUD_BOOT;
+static uint32_t link_baud_pending = 0; // agreed with the ESP32, not applied yet
+static bool link_negotiated = false;
+static absolute_time_t link_next_hello;
+static absolute_time_t link_last_rx;
+static absolute_time_t link_last_tx;
+
+// What the ESP32 last reported about our frames (LINK_MSG_STATS).
+static uint32_t link_peer_frames = 0;
+static uint32_t link_peer_crc_errors = 0;
+static uint32_t link_peer_lost = 0;
+
+// Counters, written by Core0 only.
+static volatile uint32_t link_tx_frames = 0;
+static volatile uint32_t link_tx_dropped = 0;
+static volatile uint32_t link_tx_bytes = 0;
+static volatile uint32_t link_tx_stalls = 0; // times TX found the ESP32 busy
+static volatile bool link_tx_stalled = false;
+
+/* ===================== TX ===================== */
+
+// Starts the next contiguous chunk if the channel is idle. Interrupts must be off, or this must be
+// the DMA interrupt itself. Nothing starts while a baud switch is pending: the ESP32 is already at the
+// new rate. link_poll() kicks again once it has switched.
+static void link_tx_kick(void)
+{
+    if (link_tx_inflight || link_baud_pending)
+        return;
+    uint32_t avail = link_tx_head - link_tx_tail;
+    gpio_put(link_req_pin, avail == 0);
+    if (!avail)
+        return;
+    if (!gpio_get(link_ready_pin))
+    {
+        if (!link_tx_stalled)
+            link_tx_stalls++;
+        link_tx_stalled = true;
+        return; // link_ready_irq restarts us
+    }
+    link_tx_stalled = false;
+
+    uint32_t at = link_tx_tail & (LINK_TX_SIZE - 1);
+    uint32_t n = LINK_TX_SIZE - at;
+    if (n > avail)
+        n = avail;
+    if (n > LINK_TX_CHUNK)
+        n = LINK_TX_CHUNK;
+    link_tx_inflight = n;
+    dma_channel_transfer_from_buffer_now(link_tx_dma, link_tx_ring + at, n);
+}
+
+static void link_tx_irq(void)
+{
+    if (!dma_channel_get_irq0_status(link_tx_dma))
+        return; // the IRQ line is shared
+    dma_channel_acknowledge_irq0(link_tx_dma);
+    link_tx_tail += link_tx_inflight;
+    link_tx_inflight = 0;
+    link_tx_kick();
+}
+
+// Rising edge on the ready line. The IO_IRQ_BANK0 chain is shared, and also runs on Core1 for the
+// CYW43 host wake; there this pin's event is not enabled, so the mask reads zero.
+static void link_ready_irq(void)
+{
+    if (!(gpio_get_irq_event_mask(link_ready_pin) & GPIO_IRQ_EDGE_RISE))
+        return;
+    gpio_acknowledge_irq(link_ready_pin, GPIO_IRQ_EDGE_RISE);
+    link_tx_kick();
+}
+
+// Queues one frame. False if it does not fit in the ring right now; the frame is dropped.
+static bool link_send(uint8_t type, const void *data, size_t n)
+{
+    uint8_t frame[LINK_FRAME_MAX];
+    size_t len = link_frame_encode(type, link_tx_seq, data, n, frame);
+
+    if (!len || LINK_TX_SIZE - (link_tx_head - link_tx_tail) < len)
+    {
+        link_tx_dropped++;
+        return false;
+    }
+    link_tx_seq++;
+
+    uint32_t at = link_tx_head & (LINK_TX_SIZE - 1);
+    uint32_t first = LINK_TX_SIZE - at;
+    if (first > len)
+        first = len;
+    memcpy(link_tx_ring + at, frame, first);
+    memcpy(link_tx_ring, frame + first, len - first);
+
+    uint32_t irq = save_and_disable_interrupts();
+    link_tx_head += len;
+    link_tx_kick();
+    restore_interrupts(irq);
+
+    link_tx_frames++;
+    link_tx_bytes += len;
+    link_last_tx = get_absolute_time();
+    return true;
+}
+
+// No DMA chunk running and the UART has shifted out its last bit. Frames may still be queued.
+static inline bool link_tx_idle(void)
+{
+    return !link_tx_inflight && !(uart_get_hw(link_uart)->fr & UART_UARTFR_BUSY_BITS);
+}
+
+/* ===================== RX ===================== */
+
+static void link_rx_arm(void)
+{
+    dma_channel_config c = dma_channel_get_default_config(link_rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, LINK_RX_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(link_uart, false));
+#if PICO_RP2350
+    uint32_t count = dma_encode_endless_transfer_count();
+#else
+    uint32_t count = 0xFFFFFFFF; // about 12 hours at LINK_BAUD_FAST; link_poll re-arms it
+#endif
+    dma_channel_configure(link_rx_dma, &c, link_rx_ring + (link_rx_read & (LINK_RX_SIZE - 1)),
+                          &uart_get_hw(link_uart)->dr, count, true);
+}
+
+static void link_handle(const link_msg_t *msg)
+{
+    switch (msg->type)
+    {
+    case LINK_MSG_HELLO_ACK:
+        if (msg->len >= 4 && !link_negotiated)
+        {
+            link_baud_pending = link_get_le32(msg->data);
+            link_negotiated = true;
+            link_last_rx = get_absolute_time();
+        }
+        break;
+    case LINK_MSG_STATS:
+        if (msg->len >= 12)
+        {
+            link_peer_frames = link_get_le32(msg->data);
+            link_peer_crc_errors = link_get_le32(msg->data + 4);
+            link_peer_lost = link_get_le32(msg->data + 8);
+        }
+        break;
+    case LINK_MSG_LOG:
+        printf("ESP32: %.*s\n", msg->len, (const char *)msg->data);
+        break;
+    default:
+        break;
+    }
+}
+
+/* ===================== API ===================== */
+
+static void link_init(uart_inst_t *uart, uint tx_pin, uint rx_pin, uint req_pin, uint ready_pin)
+{
+    link_uart = uart;
+    link_req_pin = req_pin;
+    link_ready_pin = ready_pin;
+
+    gpio_init(req_pin);
+    gpio_set_dir(req_pin, GPIO_OUT);
+    gpio_put(req_pin, 1);
+    gpio_init(ready_pin);
+    gpio_set_dir(ready_pin, GPIO_IN);
+    gpio_pull_up(ready_pin);
+
+    uart_init(uart, LINK_BAUD_BOOT);
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(rx_pin, GPIO_FUNC_UART);
+    uart_set_fifo_enabled(uart, true);
+
+    link_tx_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(link_tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+    dma_channel_configure(link_tx_dma, &c, &uart_get_hw(uart)->dr, link_tx_ring, 0, false);
+    dma_channel_set_irq0_enabled(link_tx_dma, true);
+    irq_add_shared_handler(DMA_IRQ_0, link_tx_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // Edges are latched even while the kick has interrupts off, so none is missed between reading
+    // the line and returning.
+    gpio_add_raw_irq_handler(ready_pin, link_ready_irq);
+    gpio_set_irq_enabled(ready_pin, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    link_rx_dma = dma_claim_unused_channel(true);
+    link_rx_arm();
+
+    link_next_hello = get_absolute_time();
+    link_last_tx = get_absolute_time();
+}
+
+// Call from the Core0 loop: decodes whatever has arrived, negotiates the baud rate, keeps the link alive.
+static void link_poll(void)
+{
+    uint32_t write_at = (uintptr_t)dma_hw->ch[link_rx_dma].write_addr - (uintptr_t)link_rx_ring;
+    uint32_t written = write_at & (LINK_RX_SIZE - 1);
+    link_msg_t msg;
+
+    while ((link_rx_read & (LINK_RX_SIZE - 1)) != written)
+    {
+        if (link_rx_byte(&link_rx, link_rx_ring[link_rx_read & (LINK_RX_SIZE - 1)], &msg) == LINK_RX_FRAME)
+        {
+            link_last_rx = get_absolute_time();
+            link_handle(&msg);
+        }
+        link_rx_read++;
+    }
+    if (!dma_channel_is_busy(link_rx_dma))
+        link_rx_arm();
+
+    if (link_negotiated && absolute_time_diff_us(link_last_rx, get_absolute_time()) > LINK_SILENCE_MS * 1000ll)
+    {
+        link_negotiated = false;
+        link_baud_pending = LINK_BAUD_BOOT; // applied below once TX is idle
+        printf("UART link silent, back to %u baud\n", LINK_BAUD_BOOT);
+    }
+    if (!link_negotiated && !link_baud_pending && time_reached(link_next_hello))
+    {
+        uint8_t baud[4];
+        put_le32(baud, LINK_BAUD_FAST);
+        link_send(LINK_MSG_HELLO, baud, sizeof(baud));
+        link_next_hello = make_timeout_time_ms(LINK_HELLO_MS);
+    }
+    if (link_baud_pending && link_tx_idle())
+    {
+        link_baud = uart_set_baudrate(link_uart, link_baud_pending);
+        link_baud_pending = 0;
+        printf("UART link at %lu baud\n", (unsigned long)link_baud);
+
+        uint32_t irq = save_and_disable_interrupts();
+        link_tx_kick(); // whatever was held goes out at the new rate
+        restore_interrupts(irq);
+    }
+    if (link_negotiated && !link_baud_pending &&
+        absolute_time_diff_us(link_last_tx, get_absolute_time()) > LINK_KEEPALIVE_MS * 1000ll)
+        link_send(LINK_MSG_KEEPALIVE, NULL, 0);
+}
+
+// Sleeps up to ms like cmdq_wait_ms(), returning as soon as a command is queued, but polls the link
+// every LINK_SERVICE_MS meanwhile: a baud switch should not wait for the next exchange, and neither
+// should the keepalive.
+static void link_wait_ms(uint32_t ms)
+{
+    absolute_time_t until = make_timeout_time_ms(ms);
+    while (cmdq_depth() == 0 && !time_reached(until))
+    {
+        int64_t left_ms = absolute_time_diff_us(get_absolute_time(), until) / 1000;
+        cmdq_wait_ms(left_ms < LINK_SERVICE_MS ? (uint32_t)left_ms : LINK_SERVICE_MS);
+        link_poll();
+    }
+}
+
+#endif
@@ -94,6 +94,20 @@ static inline uint8_t pack_led_states(bool red, bool yellow, bool green, bool re
     return (green << 0) | (yellow << 1) | (red << 2) | (relay << 3);
 }
 
+// Sets the LEDs selected by mask to the matching bits of value (same packing as pack_led_states).
+// Absolute, so applying the same command twice changes nothing.
+static void apply_led_states(uint8_t mask, uint8_t value)
+{
+    if (mask & 0x01)
+        gpio_put(LED_G, value & 0x01);
+    if (mask & 0x02)
+        gpio_put(LED_Y, (value >> 1) & 0x01);
+    if (mask & 0x04)
+        gpio_put(LED_R, (value >> 2) & 0x01);
+    if (mask & 0x08)
+        gpio_put(LED_B, (value >> 3) & 0x01);
+}
+
 void core1_main()
 {
     // This process operates on Core #2, (Core1). It is in charge of sensing and reporting the thermistor state.
@@ -135,8 +149,7 @@ int main()
     spi_setup();
 
     uint8_t out_buf[BUF_LEN], in_buf[BUF_LEN], last_received_buf[BUF_LEN];
-    uint8_t old_val = 0;
-    uint8_t color = -1;
+    uint8_t last_cmd_id = 0; // echoed back to the master until the next command arrives
 
     // Initialize output buffer
     for (size_t i = 0; i < BUF_LEN; ++i)
@@ -170,46 +183,32 @@ int main()
         bool green_state = get_led_state(LED_G);
         bool relay_state = get_led_state(LED_B);
 
-        // Pack 16-bit F
-        out_buf[0] = (uint8_t)(raw_data & 0xFF);        // LSB
-        out_buf[1] = (uint8_t)((raw_data >> 8) & 0xFF); // MSB
-        out_buf[2] = pack_led_states(red_state, yellow_state, green_state, relay_state);
+        // Byte 0: ADC LSB. Byte 1: ADC bits 8..11 and the LED states in the high nibble.
+        // Byte 2: the ID of the last command we applied, so the master knows it arrived.
+        out_buf[0] = (uint8_t)(raw_data & 0xFF);
+        out_buf[1] = (uint8_t)((raw_data >> 8) & 0x0F) |
+                     (uint8_t)(pack_led_states(red_state, yellow_state, green_state, relay_state) << 4);
+        out_buf[2] = last_cmd_id;
 
         // Perform SPI full-duplex transfer
         uint32_t received_value = spi_readwrite(out_buf, in_buf);
         printf("received_value : %06X\n", received_value);
-        uint8_t received_data_buf[3];
-        received_data_buf[0] = (received_value >> 16) & 0xFF;
-        received_data_buf[1] = (received_value >> 8) & 0xFF;
-        received_data_buf[2] = received_value;
 
-        if (received_data_buf[2] != 0 && received_data_buf[2] != old_val)
+        // Command frame from the master: ID, mask, value (all zero when it has nothing to say).
+        // The master resends the same frame until it sees the ID echoed, and applying it again is
+        // harmless, so there is nothing to de-duplicate here.
+        uint8_t cmd_id = in_buf[0];
+        uint8_t cmd_mask = in_buf[1];
+        uint8_t cmd_value = in_buf[2];
+
+        if (cmd_id != 0 && cmd_mask != 0 && (cmd_mask & 0xF0) == 0 && (cmd_value & ~cmd_mask) == 0)
         {
-            switch (received_data_buf[2])
-            {
-            case 1:
-                color = LED_G;
-                toggleLED(color, 1);
-                break;
-            case 2:
-                color = LED_Y;
-                toggleLED(color, 2);
-                break;
-            case 3:
-                color = LED_R;
-                toggleLED(color, 3);
-                break;
-            case 4:
-                color = LED_B;
-                toggleLED(color, 4);
-                break;
-            default:
-                break; // no action
-            }
+            apply_led_states(cmd_mask, cmd_value);
+            if (cmd_id != last_cmd_id)
+                printf("LED command %u: mask %X value %X\n", cmd_id, cmd_mask, cmd_value);
+            last_cmd_id = cmd_id;
         }
 
-        old_val = received_data_buf[2];
-
         gpio_put(LED_PIN, 1);
         gpio_put(LED_EXT, 1);
         sleep_ms(20);